@@ -10,6 +10,9 @@
 #include "errno_error.hpp"
 
 #include <climits>
+#include <memory>
+#include <vector>
+
 #include <poll.h>
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -230,6 +233,53 @@ unsigned short device::can_poll(std::chrono::seconds s, std::chrono::nanoseconds
     return revents;
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////
+static std::vector<pollfd> descriptors(snd_pcm_t* pcm)
+{
+    int count = snd_pcm_poll_descriptors_count(pcm);
+    if(count < 1) throw alsa_error(alsa::errc::io_error, "snd_pcm_poll_descriptors_count");
+
+    std::vector<pollfd> fds(count);
+
+    int code = snd_pcm_poll_descriptors(pcm, fds.data(), count);
+    if(code < 0) throw alsa_error(code, "snd_pcm_poll_descriptors");
+
+    return fds;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void device::add_to(app::reactor& reactor, app::reactor::callback func)
+{
+    typedef std::vector<pollfd> pollfds;
+
+    std::shared_ptr<pollfds> fds = std::make_shared<pollfds>(descriptors(_M_pcm));
+    std::shared_ptr<app::reactor::callback> shared = std::make_shared<app::reactor::callback>(std::move(func));
+
+    // poll and epoll event bits are the same on linux
+    for(const pollfd& fd : *fds)
+    {
+        snd_pcm_t* pcm = _M_pcm;
+        int id = fd.fd;
+
+        reactor.add(id, static_cast<app::event>(fd.events), [pcm, id, fds, shared](app::event events)
+        {
+            for(pollfd& fd : *fds) fd.revents = fd.fd == id ? static_cast<short>(events) : 0;
+
+            unsigned short revents;
+            int code = snd_pcm_poll_descriptors_revents(pcm, fds->data(), fds->size(), &revents);
+            if(code < 0) throw alsa_error(code, "snd_pcm_poll_descriptors_revents");
+
+            if(revents) (*shared)(static_cast<app::event>(revents));
+        });
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void device::remove_from(app::reactor& reactor)
+{
+    for(const pollfd& fd : descriptors(_M_pcm)) reactor.remove(fd.fd);
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 bool device::can_read(std::chrono::seconds s, std::chrono::nanoseconds n)
 {
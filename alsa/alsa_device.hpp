@@ -12,6 +12,7 @@
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 #include "alsa/alsa_error.hpp"
 #include "enum.hpp"
+#include "reactor/reactor.hpp"
 
 #include <chrono>
 #include <string>
@@ -309,6 +310,19 @@ public:
 
     bool can_write() { return can_write(std::chrono::seconds(-1)); }
 
+    ////////////////////
+    /// \brief  register ALSA device poll descriptors with reactor
+    /// \param  reactor reactor
+    /// \param  func callback receiving (demangled) device events
+    ///
+    void add_to(app::reactor& reactor, app::reactor::callback func);
+
+    ////////////////////
+    /// \brief  unregister ALSA device poll descriptors from reactor
+    /// \param  reactor reactor
+    ///
+    void remove_from(app::reactor& reactor);
+
 protected:
     snd_pcm_t* _M_pcm = nullptr;
 
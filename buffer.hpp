@@ -0,0 +1,160 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2015 Dimitry Ishenko
+// Distributed under the GNU GPL v2. For full terms please visit:
+// http://www.gnu.org/licenses/gpl.html
+//
+// Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef BUFFER_HPP
+#define BUFFER_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace app
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// \brief buffer
+///
+/// Reusable byte buffer for receive paths. Unlike std::string, growing it does not
+/// zero-fill and shrinking it keeps the capacity, so a buffer reused in a loop
+/// allocates at most once.
+///
+class buffer
+{
+public:
+    buffer() noexcept = default;
+    buffer(const buffer&) = delete;
+    buffer(buffer&& x) noexcept { swap(x); }
+
+    explicit buffer(size_t capacity) { reserve(capacity); }
+
+    buffer& operator=(const buffer&) = delete;
+    buffer& operator=(buffer&& x) noexcept
+    {
+        swap(x);
+        return (*this);
+    }
+
+    void swap(buffer& x) noexcept
+    {
+        std::swap(_M_data, x._M_data);
+        std::swap(_M_size, x._M_size);
+        std::swap(_M_capacity, x._M_capacity);
+    }
+
+    char* data() noexcept { return _M_data.get(); }
+    const char* data() const noexcept { return _M_data.get(); }
+
+    size_t size() const noexcept { return _M_size; }
+    size_t capacity() const noexcept { return _M_capacity; }
+    bool empty() const noexcept { return _M_size == 0; }
+
+    char* begin() noexcept { return data(); }
+    char* end() noexcept { return data() + _M_size; }
+
+    const char* begin() const noexcept { return data(); }
+    const char* end() const noexcept { return data() + _M_size; }
+
+    char& operator[](size_t n) noexcept { return _M_data[n]; }
+    const char& operator[](size_t n) const noexcept { return _M_data[n]; }
+
+    ////////////////////
+    /// \brief  grow capacity to at least n bytes (keeps contents)
+    ///
+    void reserve(size_t n)
+    {
+        if(n > _M_capacity)
+        {
+            std::unique_ptr<char[]> data(new char[n]);
+            if(_M_size) std::memcpy(data.get(), _M_data.get(), _M_size);
+
+            _M_data = std::move(data);
+            _M_capacity = n;
+        }
+    }
+
+    ////////////////////
+    /// \brief  set size to n bytes (new bytes are left uninitialized)
+    ///
+    void resize(size_t n)
+    {
+        reserve(n);
+        _M_size = n;
+    }
+
+    void clear() noexcept { _M_size = 0; }
+
+    void assign(const void* x, size_t n)
+    {
+        _M_size = 0;
+        append(x, n);
+    }
+
+    void append(const void* x, size_t n)
+    {
+        if(_M_size + n > _M_capacity) reserve(std::max(_M_size + n, 2 * _M_capacity));
+        if(n) std::memcpy(_M_data.get() + _M_size, x, n);
+        _M_size += n;
+    }
+
+    std::string to_string() const { return std::string(data(), _M_size); }
+
+private:
+    std::unique_ptr<char[]> _M_data;
+    size_t _M_size = 0;
+    size_t _M_capacity = 0;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// \brief span
+///
+/// Non-owning view of a writable memory block (for scatter/gather I/O).
+///
+struct span
+{
+    span() noexcept = default;
+    span(void* data, size_t size) noexcept: data(data), size(size) { }
+
+    span(app::buffer& x) noexcept: data(x.data()), size(x.size()) { }
+    span(std::string& x) noexcept: data(&x[0]), size(x.size()) { }
+
+    void* data = nullptr;
+    size_t size = 0;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// \brief const_span
+///
+/// Non-owning view of a read-only memory block (for scatter/gather I/O).
+///
+struct const_span
+{
+    const_span() noexcept = default;
+    const_span(const void* data, size_t size) noexcept: data(data), size(size) { }
+
+    const_span(app::span x) noexcept: data(x.data), size(x.size) { }
+    const_span(const app::buffer& x) noexcept: data(x.data()), size(x.size()) { }
+    const_span(const std::string& x) noexcept: data(x.data()), size(x.size()) { }
+    const_span(const char* x) noexcept: data(x), size(std::strlen(x)) { }
+
+    const void* data = nullptr;
+    size_t size = 0;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#endif // BUFFER_HPP
@@ -67,23 +67,33 @@ credentials::credentials(const std::string& name):
 { }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
-credentials::credentials(passwd* pwd)
+credentials::credentials(app::uid x, app::gid y):
+    credentials(get_pwd(x), y)
+{ }
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+credentials::credentials(passwd* pwd):
+    credentials(pwd, pwd->pw_gid)
+{ }
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+credentials::credentials(passwd* pwd, app::gid gid)
 {
     _M_username = pwd->pw_name;
     _M_fullname = pwd->pw_gecos;
     _M_password = pwd->pw_passwd;
 
     _M_uid = pwd->pw_uid;
-    _M_gid = pwd->pw_gid;
+    _M_gid = gid;
 
     _M_home = pwd->pw_dir;
     _M_shell = get_shell(pwd);
 
     int num = 0;
-    getgrouplist(pwd->pw_name, pwd->pw_gid, nullptr, &num);
+    getgrouplist(pwd->pw_name, gid, nullptr, &num);
 
     _M_groups.resize(num, 0);
-    getgrouplist(pwd->pw_name, pwd->pw_gid, &_M_groups[0], &num);
+    getgrouplist(pwd->pw_name, gid, &_M_groups[0], &num);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -47,12 +47,17 @@ public:
     explicit credentials(app::uid);
     explicit credentials(const std::string& name);
 
+    ////////////////////
+    /// \brief credentials of user uid, with primary group gid (eg, from SO_PEERCRED)
+    ///
+    credentials(app::uid, app::gid);
+
     const std::string& username() const noexcept { return _M_username; }
     const std::string& fullname() const noexcept { return _M_fullname; }
     const std::string& password() const noexcept { return _M_password; }
 
     app::uid uid() const noexcept { return _M_uid; }
-    app::uid gid() const noexcept { return _M_uid; }
+    app::gid gid() const noexcept { return _M_gid; }
 
     const std::string& home() const noexcept { return _M_home; }
     const std::string& shell() const noexcept { return _M_shell; }
@@ -63,6 +68,7 @@ public:
 
 private:
     credentials(passwd*);
+    credentials(passwd*, app::gid);
 
     std::string _M_username;
     std::string _M_fullname;
@@ -0,0 +1,73 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2015 Dimitry Ishenko
+// Distributed under the GNU GPL v2. For full terms please visit:
+// http://www.gnu.org/licenses/gpl.html
+//
+// Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#include "errno_error.hpp"
+#include "io_wait.hpp"
+#include "event_fd.hpp"
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace app
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+event_fd::event_fd(unsigned value, bool semaphore)
+{
+    _M_fd = eventfd(value, EFD_CLOEXEC | EFD_NONBLOCK | (semaphore ? EFD_SEMAPHORE : 0));
+    if(_M_fd == invalid) throw errno_error();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void event_fd::close() noexcept
+{
+    if(_M_fd != invalid)
+    {
+        ::close(_M_fd);
+        _M_fd = invalid;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void event_fd::send(uint64_t n)
+{
+    // EAGAIN means the counter would overflow, in which case
+    // it is as signaled as it can be
+    while(::write(_M_fd, &n, sizeof(n)) == -1)
+        if(errno == EAGAIN)
+            break;
+        else if(errno != EINTR) throw errno_error();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+uint64_t event_fd::recv(bool wait)
+{
+    for(;;)
+    {
+        uint64_t value;
+        if(::read(_M_fd, &value, sizeof(value)) == sizeof(value)) return value;
+
+        if(errno == EAGAIN)
+        {
+            if(!wait) return 0;
+            can_recv(std::chrono::seconds(-1), std::chrono::nanoseconds(0));
+        }
+        else if(errno != EINTR) throw errno_error();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool event_fd::can_recv(std::chrono::seconds s, std::chrono::nanoseconds n)
+{
+    return internal::poll_until(_M_fd, POLLIN, internal::deadline(s, n));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+}
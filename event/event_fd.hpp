@@ -0,0 +1,93 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2015 Dimitry Ishenko
+// Distributed under the GNU GPL v2. For full terms please visit:
+// http://www.gnu.org/licenses/gpl.html
+//
+// Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef EVENT_FD_HPP
+#define EVENT_FD_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#include <chrono>
+#include <cstdint>
+#include <utility>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace app
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// \brief  event counter (eventfd)
+///
+/// Wakes up a thread (or process) waiting on it with can_recv, a reactor or together
+/// with other descriptors in a single poll.
+///
+class event_fd
+{
+public:
+    typedef int id;
+    static constexpr id invalid = -1;
+
+public:
+    event_fd() noexcept = default;
+    event_fd(const event_fd&) = delete;
+    event_fd(event_fd&& x) noexcept { swap(x); }
+
+    ////////////////////
+    /// \brief  create event counter
+    /// \param  value initial counter value
+    /// \param  semaphore recv decrements counter by 1 instead of resetting it
+    ///
+    explicit event_fd(unsigned value, bool semaphore = false);
+
+    ~event_fd() { close(); }
+
+    void close() noexcept;
+    bool is_open() const noexcept { return _M_fd != invalid; }
+
+    event_fd& operator=(const event_fd&) = delete;
+    event_fd& operator=(event_fd&& x) noexcept
+    {
+        swap(x);
+        return (*this);
+    }
+
+    void swap(event_fd& x) noexcept
+    {
+        std::swap(_M_fd, x._M_fd);
+    }
+
+    ////////////////////
+    /// \brief  add n to the counter
+    ///
+    void send(uint64_t n = 1);
+
+    ////////////////////
+    /// \brief  read and reset the counter (or decrement it by 1 in semaphore mode)
+    /// \return counter value, or 0 if it is 0 and wait is false
+    ///
+    uint64_t recv(bool wait = true);
+
+    template<typename Rep, typename Period>
+    bool can_recv(const std::chrono::duration<Rep, Period>& x)
+    {
+        std::chrono::seconds s = std::chrono::duration_cast<std::chrono::seconds>(x);
+        std::chrono::nanoseconds n = std::chrono::duration_cast<std::chrono::nanoseconds>(x - s);
+        return can_recv(s, n);
+    }
+
+    event_fd::id get_id() const noexcept { return _M_fd; }
+
+protected:
+    event_fd::id _M_fd = invalid;
+
+    bool can_recv(std::chrono::seconds, std::chrono::nanoseconds);
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#endif // EVENT_FD_HPP
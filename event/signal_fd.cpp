@@ -0,0 +1,124 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2015 Dimitry Ishenko
+// Distributed under the GNU GPL v2. For full terms please visit:
+// http://www.gnu.org/licenses/gpl.html
+//
+// Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#include "errno_error.hpp"
+#include "io_wait.hpp"
+#include "signal_fd.hpp"
+
+#include <poll.h>
+#include <pthread.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace app
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+signal_fd::signal_fd(std::initializer_list<app::signal> signals)
+{
+    for(auto x : signals) sigaddset(&_M_mask, int(x));
+
+    try { update(); }
+    catch(...)
+    {
+        close();
+        throw;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void signal_fd::close() noexcept
+{
+    if(_M_fd != invalid)
+    {
+        ::close(_M_fd);
+        _M_fd = invalid;
+    }
+
+    pthread_sigmask(SIG_UNBLOCK, &_M_blocked, nullptr);
+    sigemptyset(&_M_blocked);
+    sigemptyset(&_M_mask);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void signal_fd::add(app::signal x)
+{
+    sigaddset(&_M_mask, int(x));
+    update();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void signal_fd::remove(app::signal x)
+{
+    if(_M_fd == invalid) return;
+
+    sigdelset(&_M_mask, int(x));
+    update();
+
+    if(sigismember(&_M_blocked, int(x)))
+    {
+        sigset_t set;
+        sigemptyset(&set);
+        sigaddset(&set, int(x));
+
+        int code = pthread_sigmask(SIG_UNBLOCK, &set, nullptr);
+        if(code) throw errno_error(std::error_code(code, std::generic_category()));
+
+        sigdelset(&_M_blocked, int(x));
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void signal_fd::update()
+{
+    sigset_t prev;
+    int code = pthread_sigmask(SIG_BLOCK, &_M_mask, &prev);
+    if(code) throw errno_error(std::error_code(code, std::generic_category()));
+
+    for(int n = 1; n < NSIG; ++n)
+        if(sigismember(&_M_mask, n) == 1 && !sigismember(&prev, n)) sigaddset(&_M_blocked, n);
+
+    int fd = signalfd(_M_fd, &_M_mask, SFD_CLOEXEC | SFD_NONBLOCK);
+    if(fd == invalid) throw errno_error();
+
+    _M_fd = fd;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool signal_fd::recv(app::signal_info& info, bool wait)
+{
+    for(;;)
+    {
+        signalfd_siginfo x;
+        if(::read(_M_fd, &x, sizeof(x)) == sizeof(x))
+        {
+            info.signal = static_cast<app::signal>(x.ssi_signo);
+            info.pid = x.ssi_pid;
+            info.uid = x.ssi_uid;
+            info.status = x.ssi_status;
+            return true;
+        }
+
+        if(errno == EAGAIN)
+        {
+            if(!wait) return false;
+            can_recv(std::chrono::seconds(-1), std::chrono::nanoseconds(0));
+        }
+        else if(errno != EINTR) throw errno_error();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool signal_fd::can_recv(std::chrono::seconds s, std::chrono::nanoseconds n)
+{
+    return internal::poll_until(_M_fd, POLLIN, internal::deadline(s, n));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+}
@@ -0,0 +1,126 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2015 Dimitry Ishenko
+// Distributed under the GNU GPL v2. For full terms please visit:
+// http://www.gnu.org/licenses/gpl.html
+//
+// Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef SIGNAL_FD_HPP
+#define SIGNAL_FD_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#include "process/process.hpp"
+
+#include <chrono>
+#include <initializer_list>
+#include <utility>
+
+#include <signal.h>
+#include <sys/types.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace app
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+struct signal_info
+{
+    app::signal signal = app::signal::none;
+
+    pid_t pid = 0; //< sending (or, for app::signal::child, exiting) process
+    uid_t uid = 0;
+    int status = 0; //< exit code or signal of the child (app::signal::child)
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// \brief  signal receiver (signalfd)
+///
+/// Delivers signals as readable data instead of running a handler, so they can be
+/// multiplexed with socket I/O in a single poll (or reactor).
+///
+/// Signals are blocked in the calling thread while they are watched and unblocked
+/// again on close. For a signal to reach the descriptor reliably, it must be blocked
+/// in every thread: create signal_fd before starting other threads (they inherit
+/// the mask) or block it in them too.
+///
+class signal_fd
+{
+public:
+    typedef int id;
+    static constexpr id invalid = -1;
+
+public:
+    signal_fd() noexcept = default;
+    signal_fd(const signal_fd&) = delete;
+    signal_fd(signal_fd&& x) noexcept { swap(x); }
+
+    explicit signal_fd(std::initializer_list<app::signal>);
+
+    ~signal_fd() { close(); }
+
+    void close() noexcept;
+    bool is_open() const noexcept { return _M_fd != invalid; }
+
+    signal_fd& operator=(const signal_fd&) = delete;
+    signal_fd& operator=(signal_fd&& x) noexcept
+    {
+        swap(x);
+        return (*this);
+    }
+
+    void swap(signal_fd& x) noexcept
+    {
+        std::swap(_M_fd, x._M_fd);
+        std::swap(_M_mask, x._M_mask);
+        std::swap(_M_blocked, x._M_blocked);
+    }
+
+    ////////////////////
+    /// \brief  start or stop watching signal
+    ///
+    void add(app::signal);
+    void remove(app::signal);
+
+    ////////////////////
+    /// \brief  receive signal
+    /// \return false if there is no pending signal and wait is false
+    ///
+    bool recv(app::signal_info&, bool wait = true);
+
+    ////////////////////
+    /// \brief  receive signal
+    /// \return signal, or app::signal::none if there is no pending signal and wait is false
+    ///
+    app::signal recv(bool wait = true)
+    {
+        app::signal_info info;
+        recv(info, wait);
+        return info.signal;
+    }
+
+    template<typename Rep, typename Period>
+    bool can_recv(const std::chrono::duration<Rep, Period>& x)
+    {
+        std::chrono::seconds s = std::chrono::duration_cast<std::chrono::seconds>(x);
+        std::chrono::nanoseconds n = std::chrono::duration_cast<std::chrono::nanoseconds>(x - s);
+        return can_recv(s, n);
+    }
+
+    signal_fd::id get_id() const noexcept { return _M_fd; }
+
+protected:
+    signal_fd::id _M_fd = invalid;
+
+    sigset_t _M_mask = sigset_t();    // watched signals
+    sigset_t _M_blocked = sigset_t(); // signals blocked by us (not blocked before)
+
+    void update();
+    bool can_recv(std::chrono::seconds, std::chrono::nanoseconds);
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#endif // SIGNAL_FD_HPP
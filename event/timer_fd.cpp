@@ -0,0 +1,90 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2015 Dimitry Ishenko
+// Distributed under the GNU GPL v2. For full terms please visit:
+// http://www.gnu.org/licenses/gpl.html
+//
+// Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#include "errno_error.hpp"
+#include "io_wait.hpp"
+#include "timer_fd.hpp"
+
+#include <ctime>
+
+#include <poll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace app
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+timer_fd::timer_fd(timer_fd::clock clock)
+{
+    _M_fd = timerfd_create(clock, TFD_CLOEXEC | TFD_NONBLOCK);
+    if(_M_fd == invalid) throw errno_error();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void timer_fd::close() noexcept
+{
+    if(_M_fd != invalid)
+    {
+        ::close(_M_fd);
+        _M_fd = invalid;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void timer_fd::set(std::chrono::seconds s, std::chrono::nanoseconds n, std::chrono::seconds is, std::chrono::nanoseconds in)
+{
+    itimerspec time =
+    {
+        { static_cast<std::time_t>(is.count()), static_cast<long>(in.count()) },
+        { static_cast<std::time_t>(s.count()), static_cast<long>(n.count()) }
+    };
+
+    // zero would disarm the timer instead
+    if(time.it_value.tv_sec < 0 || (time.it_value.tv_sec == 0 && time.it_value.tv_nsec <= 0))
+    {
+        time.it_value.tv_sec = 0;
+        time.it_value.tv_nsec = 1;
+    }
+
+    if(timerfd_settime(_M_fd, 0, &time, nullptr)) throw errno_error();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void timer_fd::cancel()
+{
+    itimerspec time = { };
+    if(timerfd_settime(_M_fd, 0, &time, nullptr)) throw errno_error();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+uint64_t timer_fd::recv(bool wait)
+{
+    for(;;)
+    {
+        uint64_t count;
+        if(::read(_M_fd, &count, sizeof(count)) == sizeof(count)) return count;
+
+        if(errno == EAGAIN)
+        {
+            if(!wait) return 0;
+            can_recv(std::chrono::seconds(-1), std::chrono::nanoseconds(0));
+        }
+        else if(errno != EINTR) throw errno_error();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool timer_fd::can_recv(std::chrono::seconds s, std::chrono::nanoseconds n)
+{
+    return internal::poll_until(_M_fd, POLLIN, internal::deadline(s, n));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+}
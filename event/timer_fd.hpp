@@ -0,0 +1,122 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2015 Dimitry Ishenko
+// Distributed under the GNU GPL v2. For full terms please visit:
+// http://www.gnu.org/licenses/gpl.html
+//
+// Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef TIMER_FD_HPP
+#define TIMER_FD_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#include <chrono>
+#include <cstdint>
+#include <utility>
+
+#include <time.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace app
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// \brief  timer (timerfd)
+///
+/// Becomes readable when it expires, so periodic work can be multiplexed with
+/// socket I/O in a single poll (or reactor) instead of sleeping.
+///
+class timer_fd
+{
+public:
+    typedef int id;
+    static constexpr id invalid = -1;
+
+    enum clock
+    {
+        monotonic = CLOCK_MONOTONIC,
+        realtime  = CLOCK_REALTIME,
+        boottime  = CLOCK_BOOTTIME, //< monotonic, including time suspended
+    };
+
+public:
+    timer_fd() noexcept = default;
+    timer_fd(const timer_fd&) = delete;
+    timer_fd(timer_fd&& x) noexcept { swap(x); }
+
+    ////////////////////
+    /// \brief  create disarmed timer
+    ///
+    explicit timer_fd(timer_fd::clock);
+
+    ~timer_fd() { close(); }
+
+    void close() noexcept;
+    bool is_open() const noexcept { return _M_fd != invalid; }
+
+    timer_fd& operator=(const timer_fd&) = delete;
+    timer_fd& operator=(timer_fd&& x) noexcept
+    {
+        swap(x);
+        return (*this);
+    }
+
+    void swap(timer_fd& x) noexcept
+    {
+        std::swap(_M_fd, x._M_fd);
+    }
+
+    ////////////////////
+    /// \brief  arm timer
+    /// \param  x time until the first expiry (zero expires immediately)
+    /// \param  interval time between subsequent expiries (zero = one-shot)
+    ///
+    template<typename Rep, typename Period, typename Rep2, typename Period2>
+    void set(const std::chrono::duration<Rep, Period>& x, const std::chrono::duration<Rep2, Period2>& interval)
+    {
+        std::chrono::seconds s = std::chrono::duration_cast<std::chrono::seconds>(x);
+        std::chrono::nanoseconds n = std::chrono::duration_cast<std::chrono::nanoseconds>(x - s);
+
+        std::chrono::seconds is = std::chrono::duration_cast<std::chrono::seconds>(interval);
+        std::chrono::nanoseconds in = std::chrono::duration_cast<std::chrono::nanoseconds>(interval - is);
+
+        set(s, n, is, in);
+    }
+
+    template<typename Rep, typename Period>
+    void set(const std::chrono::duration<Rep, Period>& x) { set(x, std::chrono::seconds(0)); }
+
+    ////////////////////
+    /// \brief  disarm timer
+    ///
+    void cancel();
+
+    ////////////////////
+    /// \brief  wait for the timer to expire
+    /// \return number of expiries since the last recv, or 0 if there were none
+    ///         and wait is false
+    ///
+    uint64_t recv(bool wait = true);
+
+    template<typename Rep, typename Period>
+    bool can_recv(const std::chrono::duration<Rep, Period>& x)
+    {
+        std::chrono::seconds s = std::chrono::duration_cast<std::chrono::seconds>(x);
+        std::chrono::nanoseconds n = std::chrono::duration_cast<std::chrono::nanoseconds>(x - s);
+        return can_recv(s, n);
+    }
+
+    timer_fd::id get_id() const noexcept { return _M_fd; }
+
+protected:
+    timer_fd::id _M_fd = invalid;
+
+    void set(std::chrono::seconds, std::chrono::nanoseconds, std::chrono::seconds, std::chrono::nanoseconds);
+    bool can_recv(std::chrono::seconds, std::chrono::nanoseconds);
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#endif // TIMER_FD_HPP
@@ -0,0 +1,85 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2015 Dimitry Ishenko
+// Distributed under the GNU GPL v2. For full terms please visit:
+// http://www.gnu.org/licenses/gpl.html
+//
+// Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef IO_WAIT_HPP
+#define IO_WAIT_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#include "errno_error.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <ctime>
+
+#include <poll.h>
+#include <sys/uio.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace app
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// helpers shared by the blocking send_all/recv_exact and write_all/read_exact loops
+namespace internal
+{
+
+typedef std::chrono::steady_clock clock;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// negative timeout means no deadline
+inline clock::time_point deadline(std::chrono::seconds s, std::chrono::nanoseconds n)
+{
+    if(s.count() < 0 || (s.count() == 0 && n.count() < 0)) return clock::time_point::max();
+    return clock::now() + s + n;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// wait for events on fd until deadline, false if it has passed
+inline bool poll_until(int fd, short events, clock::time_point time)
+{
+    for(pollfd pfd = { fd, events, 0 };;)
+    {
+        timespec left, *timeout = nullptr;
+        if(time != clock::time_point::max())
+        {
+            std::chrono::nanoseconds n = std::max(time - clock::now(), clock::duration::zero());
+            left.tv_sec = std::chrono::duration_cast<std::chrono::seconds>(n).count();
+            left.tv_nsec = (n % std::chrono::seconds(1)).count();
+            timeout = &left;
+        }
+
+        int count = ppoll(&pfd, 1, timeout, nullptr);
+        if(count == -1)
+        {
+            if(errno == EINTR) continue;
+            throw errno_error();
+        }
+        return count;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// drop count bytes from the front of iov and skip empty buffers
+inline void advance(iovec*& iov, size_t& n, size_t count)
+{
+    for(; n && count >= iov->iov_len; ++iov, --n) count -= iov->iov_len;
+    if(n)
+    {
+        iov->iov_base = static_cast<char*>(iov->iov_base) + count;
+        iov->iov_len -= count;
+    }
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#endif // IO_WAIT_HPP
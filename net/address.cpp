@@ -9,6 +9,11 @@
 #include "address.hpp"
 #include "errno_error.hpp"
 
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <system_error>
+
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
@@ -22,28 +27,152 @@ const address address::any(INADDR_ANY);
 const address address::broadcast(INADDR_BROADCAST);
 const address address::loopback(INADDR_LOOPBACK);
 
+const address address::any_v6(in6addr_any);
+const address address::loopback_v6(in6addr_loopback);
+
+constexpr size_t address::max_chars;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+address::address(in_addr_t x) noexcept: address()
+{
+    _M_v4.s_addr = htonl(x);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+address::address(const char* x): address()
+{
+    // one grammar for both, see from_chars
+    if(from_chars(x, x + strlen(x), *this).ec != std::errc())
+        throw errno_error(std::make_error_code(std::errc::invalid_argument));
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
-address::address(in_addr_t x) noexcept
+to_chars_result to_chars(char* first, char* last, const net::address& x) noexcept
 {
-    _M_addr.s_addr = htonl(x);
+    char buffer[address::max_chars + 1];
+    char* end = buffer;
+
+    if(x.is_v4())
+    {
+        const unsigned char* byte = reinterpret_cast<const unsigned char*>(&x._M_v4);
+        for(int n = 0; n < 4; ++n)
+        {
+            if(n) *end++ = '.';
+
+            unsigned v = byte[n];
+            if(v >= 100) *end++ = '0' + v / 100;
+            if(v >= 10) *end++ = '0' + v / 10 % 10;
+            *end++ = '0' + v % 10;
+        }
+    }
+    else
+    {
+        inet_ntop(AF_INET6, &x._M_v6, buffer, sizeof(buffer));
+        end += strlen(buffer);
+    }
+
+    size_t size = end - buffer;
+    if(size > size_t(last - first)) return to_chars_result { last, std::errc::value_too_large };
+
+    memcpy(first, buffer, size);
+    return to_chars_result { first + size, std::errc() };
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
-address::address(const std::string& x)
+from_chars_result from_chars(const char* first, const char* last, net::address& x) noexcept
 {
-    if(!inet_aton(x.data(), &_M_addr)) throw errno_error();
+    size_t size = last - first;
+    if(size == 0 || size > address::max_chars) return from_chars_result { first, std::errc::invalid_argument };
+
+    // inet_aton stops at (and accepts) whitespace, so the whole range would not be parsed
+    for(const char* p = first; p != last; ++p)
+        if(isspace(static_cast<unsigned char>(*p))) return from_chars_result { first, std::errc::invalid_argument };
+
+    // inet_aton and inet_pton need null-terminated string
+    char buffer[address::max_chars + 1];
+    memcpy(buffer, first, size);
+    buffer[size] = '\0';
+
+    net::address result;
+    if(memchr(buffer, ':', size))
+    {
+        result._M_family = net::family::v6;
+        if(inet_pton(AF_INET6, buffer, &result._M_v6) != 1) return from_chars_result { first, std::errc::invalid_argument };
+    }
+    else if(!inet_aton(buffer, &result._M_v4)) return from_chars_result { first, std::errc::invalid_argument };
+
+    x = result;
+    return from_chars_result { last, std::errc() };
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 std::string address::to_string() const
 {
-    return inet_ntoa(_M_addr);
+    char buffer[max_chars];
+    return std::string(buffer, to_chars(buffer, buffer + sizeof(buffer), *this).ptr);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+address address::to_v6() const noexcept
+{
+    if(is_v6()) return *this;
+    if(_M_v4.s_addr == INADDR_ANY) return any_v6;
+
+    address x(in6addr_any);
+    x._M_v6.s6_addr[10] = x._M_v6.s6_addr[11] = 0xff;
+    memcpy(&x._M_v6.s6_addr[12], &_M_v4, sizeof(_M_v4));
+
+    return x;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+address address::to_v4() const noexcept
+{
+    if(!is_v4_mapped()) return *this;
+
+    address x;
+    memcpy(&x._M_v4, &_M_v6.s6_addr[12], sizeof(x._M_v4));
+
+    return x;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 in_addr_t address::value() const
 {
-    return ntohl(_M_addr.s_addr);
+    address x = to_v4();
+    if(!x.is_v4()) throw errno_error(std::make_error_code(std::errc::address_family_not_supported));
+
+    return ntohl(x._M_v4.s_addr);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool address::operator==(const address& x) const noexcept
+{
+    return _M_family == x._M_family && (is_v4()
+        ? _M_v4.s_addr == x._M_v4.s_addr
+        : !memcmp(&_M_v6, &x._M_v6, sizeof(_M_v6))
+    );
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool address::operator<(const address& x) const noexcept
+{
+    if(_M_family != x._M_family) return _M_family == net::family::v4;
+
+    return is_v4()
+        ? memcmp(&_M_v4, &x._M_v4, sizeof(_M_v4)) < 0
+        : memcmp(&_M_v6, &x._M_v6, sizeof(_M_v6)) < 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t address::hash() const noexcept
+{
+    if(is_v4()) return std::hash<in_addr_t>()(_M_v4.s_addr);
+
+    uint64_t x[2];
+    memcpy(x, &_M_v6, sizeof(x));
+
+    return std::hash<uint64_t>()(x[0] ^ (x[1] * 0x9e3779b97f4a7c15ULL));
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
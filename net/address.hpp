@@ -10,8 +10,12 @@
 #define ADDRESS_HPP
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
+#include <cstddef>
+#include <functional>
 #include <string>
+#include <system_error>
 #include <netinet/in.h>
+#include <sys/socket.h>
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 namespace net
@@ -21,6 +25,52 @@ namespace net
 class socket;
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
+enum class family : sa_family_t
+{
+    v4 = AF_INET,
+    v6 = AF_INET6,
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+struct to_chars_result
+{
+    char* ptr;
+    std::errc ec;
+};
+
+struct from_chars_result
+{
+    const char* ptr;
+    std::errc ec;
+};
+
+class address;
+
+////////////////////
+///
+/// \brief format address into [first, last) (without terminating null)
+/// \return ptr past the last char written, or ec = value_too_large if it does not fit
+///
+/// Thread-safe and does not allocate. address::max_chars is always enough.
+///
+to_chars_result to_chars(char* first, char* last, const net::address&) noexcept;
+
+////////////////////
+///
+/// \brief parse address from [first, last)
+/// \return ptr past the last char parsed, or ec = invalid_argument on failure
+///
+/// Accepts IPv6 notation, or IPv4 in any form inet_aton(3) takes: dotted quad, or fewer parts
+/// (eg, 10.1 = 10.0.0.1), each part in decimal, octal (leading 0) or hex (leading 0x).
+/// The address(const char*) constructor uses the same grammar. Does not allocate.
+///
+from_chars_result from_chars(const char* first, const char* last, net::address&) noexcept;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// \brief IPv4 or IPv6 address
+///
+/// Fixed size and trivially copyable; cheap to pass by value.
+///
 class address
 {
 public:
@@ -28,8 +78,13 @@ public:
     static const address broadcast;
     static const address loopback;
 
+    static const address any_v6;
+    static const address loopback_v6;
+
+    static constexpr size_t max_chars = INET6_ADDRSTRLEN - 1;
+
 public:
-    address() noexcept = default;
+    address() noexcept: _M_family(net::family::v4), _M_v6() { }
     address(const address&) noexcept = default;
     address(address&&) noexcept = default;
 
@@ -50,25 +105,97 @@ public:
     ///
     address(in_addr_t x) noexcept;
 
-    address(const std::string&);
-    address(const char* x): address(std::string(x)) { }
+    ////////////////////
+    ///
+    /// \brief IPv6 address constructor
+    /// \param x in network byte order
+    ///
+    address(const in6_addr& x) noexcept: _M_family(net::family::v6), _M_v6(x) { }
+
+    address(const std::string& x): address(x.data()) { }
+
+    ////////////////////
+    ///
+    /// \brief parse IPv4 (dotted) or IPv6 (colon) notation
+    ///
+    /// Same grammar as from_chars; throws invalid_argument on failure.
+    ///
+    address(const char*);
 
     std::string to_string() const;
 
+    net::family family() const noexcept { return _M_family; }
+    bool is_v4() const noexcept { return _M_family == net::family::v4; }
+    bool is_v6() const noexcept { return _M_family == net::family::v6; }
+
+    ////////////////////
+    ///
+    /// \brief check if this is an IPv4-mapped IPv6 address (::ffff:a.b.c.d)
+    ///
+    bool is_v4_mapped() const noexcept { return is_v6() && IN6_IS_ADDR_V4MAPPED(&_M_v6); }
+
+    ////////////////////
+    ///
+    /// \brief convert to IPv6 (IPv4 addresses are mapped, except any)
+    ///
+    address to_v6() const noexcept;
+
+    ////////////////////
+    ///
+    /// \brief convert IPv4-mapped address back to IPv4
+    ///
+    address to_v4() const noexcept;
+
     ////////////////////
     ///
     /// \brief value
     /// \return in host byte order (!)
     ///
+    /// Throws errno_error if this is an IPv6 address, which is not IPv4-mapped.
+    ///
     in_addr_t value() const;
 
+    bool operator==(const address&) const noexcept;
+    bool operator!=(const address& x) const noexcept { return !(*this == x); }
+
+    ////////////////////
+    ///
+    /// \brief ordering: IPv4 before IPv6, then by numeric value
+    ///
+    bool operator<(const address&) const noexcept;
+    bool operator>(const address& x) const noexcept { return x < *this; }
+    bool operator<=(const address& x) const noexcept { return !(x < *this); }
+    bool operator>=(const address& x) const noexcept { return !(*this < x); }
+
+    size_t hash() const noexcept;
+
 private:
-    in_addr _M_addr; // in network byte order (big endian)
+    net::family _M_family;
+    union
+    {
+        in_addr _M_v4; // in network byte order (big endian)
+        in6_addr _M_v6;
+    };
+
     friend class net::socket;
+    friend to_chars_result to_chars(char*, char*, const net::address&) noexcept;
+    friend from_chars_result from_chars(const char*, const char*, net::address&) noexcept;
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace std
+{
+
+template<>
+struct hash<net::address>
+{
+    size_t operator()(const net::address& x) const noexcept { return x.hash(); }
+};
+
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 #endif // ADDRESS_HPP
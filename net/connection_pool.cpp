@@ -0,0 +1,172 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2015 Dimitry Ishenko
+// Distributed under the GNU GPL v2. For full terms please visit:
+// http://www.gnu.org/licenses/gpl.html
+//
+// Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#include "connection_pool.hpp"
+
+#include <utility>
+#include <vector>
+
+#include <sys/socket.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace net
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+connection_pool::connection_pool(size_t max_idle, size_t max_total, size_t stripes):
+    _M_max_idle(max_idle), _M_max_total(max_total ? max_total : 1),
+    _M_size(stripes ? stripes : 1), _M_stripes(new stripe[_M_size])
+{ }
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool connection_pool::healthy(net::socket& socket)
+{
+    if(!socket.is_open()) return false;
+    if(!socket.can_recv(std::chrono::seconds(0))) return true;
+
+    // readable idle connection means either the peer closed it (0),
+    // there was an error (-1) or it sent something we did not ask for (>0)
+    char c;
+    ssize_t count = ::recv(socket.get_id(), &c, sizeof(c), MSG_PEEK | MSG_DONTWAIT);
+    return count == -1 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+net::socket connection_pool::acquire(net::address address, net::port port)
+{
+    key k = { address, port };
+    stripe& s = stripe_for(k);
+
+    std::unique_lock<std::mutex> lock(s.mutex);
+    for(;;)
+    {
+        entry& e = s.map[k];
+        if(!e.idle.empty())
+        {
+            net::socket socket = std::move(e.idle.back().socket);
+            e.idle.pop_back();
+
+            lock.unlock();
+            if(healthy(socket)) return socket;
+
+            socket.close();
+            lock.lock();
+
+            --s.map[k].total;
+            continue;
+        }
+
+        if(e.total < _M_max_total)
+        {
+            ++e.total;
+            lock.unlock();
+
+            try
+            {
+                net::socket socket(net::socket::stream, address.family());
+                socket.connect(address, port);
+                return socket;
+            }
+            catch(...)
+            {
+                lock.lock();
+                --s.map[k].total;
+
+                // waiters for other keys share the stripe's cond
+                s.cond.notify_all();
+                throw;
+            }
+        }
+
+        s.cond.wait(lock);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void connection_pool::release(net::address address, net::port port, net::socket&& socket, bool reuse)
+{
+    key k = { address, port };
+    stripe& s = stripe_for(k);
+
+    // closed after the lock is released
+    net::socket evicted, closed;
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        entry& e = s.map[k];
+
+        if(reuse && socket.is_open() && _M_max_idle)
+        {
+            e.idle.push_back(connection { std::move(socket), clock::now() });
+            if(e.idle.size() > _M_max_idle)
+            {
+                evicted = std::move(e.idle.front().socket);
+                e.idle.pop_front();
+                --e.total;
+            }
+        }
+        else
+        {
+            closed = std::move(socket);
+            if(e.total) --e.total;
+        }
+    }
+    s.cond.notify_all();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t connection_pool::evict_before(clock::time_point time)
+{
+    size_t count = 0;
+
+    for(size_t n = 0; n < _M_size; ++n)
+    {
+        stripe& s = _M_stripes[n];
+
+        std::vector<net::socket> evicted;
+        {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            for(auto ri = s.map.begin(); ri != s.map.end(); )
+            {
+                entry& e = ri->second;
+                while(!e.idle.empty() && e.idle.front().time <= time)
+                {
+                    evicted.push_back(std::move(e.idle.front().socket));
+                    e.idle.pop_front();
+                    --e.total;
+                }
+
+                if(e.total == 0)
+                    ri = s.map.erase(ri);
+                else ++ri;
+            }
+        }
+
+        if(evicted.size())
+        {
+            count += evicted.size();
+            s.cond.notify_all();
+        }
+    }
+
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t connection_pool::idle()
+{
+    size_t count = 0;
+    for(size_t n = 0; n < _M_size; ++n)
+    {
+        std::lock_guard<std::mutex> lock(_M_stripes[n].mutex);
+        for(const auto& x : _M_stripes[n].map) count += x.second.idle.size();
+    }
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+}
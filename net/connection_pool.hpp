@@ -0,0 +1,137 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2015 Dimitry Ishenko
+// Distributed under the GNU GPL v2. For full terms please visit:
+// http://www.gnu.org/licenses/gpl.html
+//
+// Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef CONNECTION_POOL_HPP
+#define CONNECTION_POOL_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#include "net_socket.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace net
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// \brief  TCP connection pool
+///
+/// Keeps connected stream sockets per (address, port) for reuse. Thread-safe; keys are
+/// spread over a number of independently locked stripes, so threads talking to different
+/// endpoints rarely contend.
+///
+class connection_pool
+{
+public:
+    typedef std::chrono::steady_clock clock;
+
+public:
+    ////////////////////
+    /// \brief  construct connection pool
+    /// \param  max_idle max number of idle connections kept per endpoint
+    /// \param  max_total max number of connections (idle + checked out) per endpoint
+    /// \param  stripes number of lock stripes
+    ///
+    explicit connection_pool(size_t max_idle = 8, size_t max_total = 64, size_t stripes = 16);
+    connection_pool(const connection_pool&) = delete;
+    connection_pool(connection_pool&&) = delete;
+
+    connection_pool& operator=(const connection_pool&) = delete;
+    connection_pool& operator=(connection_pool&&) = delete;
+
+    ////////////////////
+    /// \brief  check out connection to address:port
+    ///
+    /// Reuses the most recently returned idle connection that passes the health check
+    /// (peer has not closed it and sent nothing unsolicited), or connects a new one.
+    /// Blocks while max_total connections to address:port are checked out.
+    ///
+    net::socket acquire(net::address address, net::port port);
+
+    ////////////////////
+    /// \brief  return connection to the pool
+    /// \param  reuse whether the connection can be reused (pass false if it is broken
+    ///         or in an unknown protocol state)
+    ///
+    /// The least recently used idle connection is closed if there are more than max_idle.
+    ///
+    void release(net::address address, net::port port, net::socket&& socket, bool reuse = true);
+
+    ////////////////////
+    /// \brief  close connections that have been idle longer than x
+    /// \return number of connections closed
+    ///
+    template<typename Rep, typename Period>
+    size_t evict(const std::chrono::duration<Rep, Period>& x)
+    {
+        return evict_before(clock::now() - std::chrono::duration_cast<clock::duration>(x));
+    }
+
+    ////////////////////
+    /// \brief  close all idle connections
+    ///
+    void clear() { evict_before(clock::now()); }
+
+    size_t idle();
+
+private:
+    struct key
+    {
+        net::address address;
+        net::port port;
+
+        bool operator==(const key& x) const noexcept { return address == x.address && port == x.port; }
+    };
+
+    struct key_hash
+    {
+        size_t operator()(const key& x) const noexcept { return (std::hash<net::address>()(x.address) << 16) ^ x.port; }
+    };
+
+    struct connection
+    {
+        net::socket socket;
+        clock::time_point time;
+    };
+
+    struct entry
+    {
+        std::deque<connection> idle; // oldest first
+        size_t total = 0;
+    };
+
+    struct stripe
+    {
+        std::mutex mutex;
+        std::condition_variable cond;
+        std::unordered_map<key, entry, key_hash> map;
+    };
+
+    size_t _M_max_idle, _M_max_total;
+
+    size_t _M_size;
+    std::unique_ptr<stripe[]> _M_stripes;
+
+    stripe& stripe_for(const key& x) { return _M_stripes[key_hash()(x) % _M_size]; }
+
+    static bool healthy(net::socket&);
+    // close connections idle since time or earlier
+    size_t evict_before(clock::time_point);
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#endif // CONNECTION_POOL_HPP
@@ -0,0 +1,70 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2015 Dimitry Ishenko
+// Distributed under the GNU GPL v2. For full terms please visit:
+// http://www.gnu.org/licenses/gpl.html
+//
+// Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#include "listener_group.hpp"
+
+#include <vector>
+
+#include <sched.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace net
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace
+{
+
+// cpus this process may run on (ids can be sparse)
+std::vector<int> allowed_cpus()
+{
+    std::vector<int> cpus;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if(sched_getaffinity(0, sizeof(set), &set) == 0)
+        for(int n = 0; n < CPU_SETSIZE; ++n)
+            if(CPU_ISSET(n, &set)) cpus.push_back(n);
+
+    if(cpus.empty()) cpus.push_back(0);
+    return cpus;
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+listener_group::listener_group(net::address address, net::port port, size_t count, bool pin, int max)
+{
+    std::vector<int> cpus = allowed_cpus();
+    if(count == 0) count = cpus.size();
+
+    _M_sockets.reserve(count);
+    for(size_t n = 0; n < count; ++n)
+    {
+        net::socket socket(net::socket::stream, address.family());
+
+        socket.set_reuse_port(true);
+        if(pin) socket.set_incoming_cpu(cpus[n % cpus.size()]);
+
+        socket.bind(address, port);
+        if(port == 0)
+        {
+            // the rest join the port picked for the first one
+            net::address bound;
+            socket.local_address(bound, port);
+        }
+
+        socket.listen(max);
+        socket.set_non_blocking(true);
+
+        _M_sockets.push_back(std::move(socket));
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+}
@@ -0,0 +1,95 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2015 Dimitry Ishenko
+// Distributed under the GNU GPL v2. For full terms please visit:
+// http://www.gnu.org/licenses/gpl.html
+//
+// Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef LISTENER_GROUP_HPP
+#define LISTENER_GROUP_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#include "net_socket.hpp"
+
+#include <cstddef>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace net
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// \brief  group of listening sockets sharing one address:port (SO_REUSEPORT)
+///
+/// Each worker thread accepts from its own listener, and the kernel balances new
+/// connections between them, so there is no shared accept queue and no thundering herd.
+///
+class listener_group
+{
+public:
+    listener_group() noexcept = default;
+    listener_group(const listener_group&) = delete;
+    listener_group(listener_group&& x) noexcept { swap(x); }
+
+    ////////////////////
+    /// \brief  construct listener group
+    /// \param  address address to listen on
+    /// \param  port port to listen on (0 = pick a free port, shared by all listeners)
+    /// \param  count number of listeners (0 = one per cpu in the affinity mask)
+    /// \param  pin tie listener n to the n-th cpu in the affinity mask (SO_INCOMING_CPU)
+    /// \param  max listen backlog of each listener
+    ///
+    listener_group(net::address address, net::port port, size_t count = 0, bool pin = false, int max = 128);
+    explicit listener_group(net::port port, size_t count = 0, bool pin = false, int max = 128):
+        listener_group(net::address::any, port, count, pin, max)
+    { }
+
+    listener_group& operator=(const listener_group&) = delete;
+    listener_group& operator=(listener_group&& x) noexcept
+    {
+        swap(x);
+        return (*this);
+    }
+
+    void swap(listener_group& x) noexcept
+    {
+        std::swap(_M_sockets, x._M_sockets);
+    }
+
+    void close() noexcept { _M_sockets.clear(); }
+
+    size_t size() const noexcept { return _M_sockets.size(); }
+
+    ////////////////////
+    /// \brief  get listener n (eg, to register it with a reactor)
+    ///
+    net::socket& operator[](size_t n) noexcept { return _M_sockets[n]; }
+
+    ////////////////////
+    /// \brief  accept connection on listener n without blocking
+    /// \return false if there is no pending connection
+    ///
+    /// The accepted socket is non-blocking and close-on-exec.
+    ///
+    bool accept(size_t n, net::socket& socket, net::address& address, net::port& port)
+    {
+        return _M_sockets[n].accept(socket, address, port, false, true);
+    }
+
+    bool accept(size_t n, net::socket& socket)
+    {
+        net::address address;
+        net::port port;
+        return accept(n, socket, address, port);
+    }
+
+private:
+    std::vector<net::socket> _M_sockets;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#endif // LISTENER_GROUP_HPP
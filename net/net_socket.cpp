@@ -9,10 +9,12 @@
 #include "errno_error.hpp"
 #include "net_socket.hpp"
 
+#include <algorithm>
 #include <cstring>
-#include <memory>
+#include <system_error>
 
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 
@@ -21,129 +23,375 @@ namespace net
 {
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
-socket::socket(type x): app::socket(AF_INET, x)
+socket::socket(type x, net::family family): app::socket(static_cast<int>(family), x), _M_family(family)
 {
     int val = 1;
     if(setsockopt(_M_fd, SOL_SOCKET, SO_REUSEADDR, &val, sizeof(val))) throw errno_error();
+
+    if(_M_family == net::family::v6) set_v6_only(false);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
-sockaddr_in socket::from(net::address address, net::port port)
+socklen_t socket::from(net::address address, net::port port, sockaddr_storage& storage) const
 {
-    sockaddr_in addr;
+    memset(&storage, 0, sizeof(storage));
+
+    if(_M_family == net::family::v6)
+    {
+        sockaddr_in6& addr = reinterpret_cast<sockaddr_in6&>(storage);
+
+        addr.sin6_family = AF_INET6;
+        addr.sin6_addr = address.to_v6()._M_v6;
+        addr.sin6_port = htons(port);
+
+        return sizeof(addr);
+    }
+    else
+    {
+        if(!address.is_v4() && !address.is_v4_mapped())
+            throw errno_error(std::make_error_code(std::errc::address_family_not_supported));
+
+        sockaddr_in& addr = reinterpret_cast<sockaddr_in&>(storage);
+
+        addr.sin_family = AF_INET;
+        addr.sin_addr = address.to_v4()._M_v4;
+        addr.sin_port = htons(port);
+
+        return sizeof(addr);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void socket::to(const sockaddr_storage& storage, net::address& address, net::port& port)
+{
+    if(storage.ss_family == AF_INET)
+    {
+        const sockaddr_in& addr = reinterpret_cast<const sockaddr_in&>(storage);
+
+        address = net::address();
+        address._M_v4 = addr.sin_addr;
+        port = ntohs(addr.sin_port);
+    }
+    else if(storage.ss_family == AF_INET6)
+    {
+        const sockaddr_in6& addr = reinterpret_cast<const sockaddr_in6&>(storage);
 
-    addr.sin_family = AF_INET;
-    addr.sin_addr = address._M_addr;
-    addr.sin_port = htons(port);
+        address = net::address(addr.sin6_addr).to_v4();
+        port = ntohs(addr.sin6_port);
+    }
+}
 
-    return addr;
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void socket::set_v6_only(bool x)
+{
+    set_option(IPPROTO_IPV6, IPV6_V6ONLY, x ? 1 : 0);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 void socket::bind(net::address address, net::port port)
 {
-    sockaddr_in addr = from(address, port);
-    base::bind((sockaddr*)&addr, sizeof(addr));
+    sockaddr_storage addr;
+    base::bind((sockaddr*)&addr, from(address, port, addr));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void socket::local_address(net::address& address, net::port& port) const
+{
+    sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    memset(&addr, 0, len);
+
+    if(getsockname(_M_fd, (sockaddr*)&addr, &len)) throw errno_error();
+    to(addr, address, port);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 void socket::accept(net::socket& socket, net::address& address, net::port& port)
 {
-    sockaddr_in addr;
+    sockaddr_storage addr;
     socklen_t len = sizeof(addr);
+    memset(&addr, 0, len);
 
     socket._M_fd = ::accept(_M_fd, (sockaddr*)&addr, &len);
     if(socket._M_fd == invalid) throw errno_error();
 
-    if(addr.sin_family == AF_INET)
-    {
-        address._M_addr.s_addr = addr.sin_addr.s_addr;
-        port = ntohs(addr.sin_port);
-    }
+    socket._M_family = _M_family;
+    to(addr, address, port);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool socket::accept(net::socket& socket, net::address& address, net::port& port, bool wait, bool non_block)
+{
+    sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    memset(&addr, 0, len);
+
+    if(!base::accept(socket, (sockaddr*)&addr, &len, SOCK_CLOEXEC | (non_block ? SOCK_NONBLOCK : 0), wait))
+        return false;
+
+    socket._M_family = _M_family;
+    to(addr, address, port);
+
+    return true;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 void socket::connect(net::address address, net::port port)
 {
-    sockaddr_in addr = from(address, port);
-    base::connect((sockaddr*)&addr, sizeof(addr));
+    sockaddr_storage addr;
+    base::connect((sockaddr*)&addr, from(address, port, addr));
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
-void socket::set_multicast_loop(bool x)
+void socket::connect(net::address address, net::port port, std::chrono::seconds s, std::chrono::nanoseconds n)
 {
-    int val = x ? 1 : 0;
-    if(setsockopt(_M_fd, IPPROTO_IP, IP_MULTICAST_LOOP, &val, sizeof(val))) throw errno_error();
+    sockaddr_storage addr;
+    base::connect((sockaddr*)&addr, from(address, port, addr), s, n);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
-void socket::set_multicast_ttl(int x)
+bool socket::begin_connect(net::address address, net::port port)
 {
-    if(setsockopt(_M_fd, IPPROTO_IP, IP_MULTICAST_TTL, &x, sizeof(x))) throw errno_error();
+    sockaddr_storage addr;
+    return base::begin_connect((sockaddr*)&addr, from(address, port, addr));
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
-void socket::set_multicast_all(bool x)
+void socket::set_reuse_port(bool x)
 {
     int val = x ? 1 : 0;
-    if(setsockopt(_M_fd, IPPROTO_IP, IP_MULTICAST_ALL, &val, sizeof(val))) throw errno_error();
+    if(setsockopt(_M_fd, SOL_SOCKET, SO_REUSEPORT, &val, sizeof(val))) throw errno_error();
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
-void socket::add_membership(net::address group)
+void socket::set_incoming_cpu(int x)
 {
-    ip_mreq imr;
-    imr.imr_multiaddr = group._M_addr;
-    imr.imr_interface = net::address::any._M_addr;
+    if(setsockopt(_M_fd, SOL_SOCKET, SO_INCOMING_CPU, &x, sizeof(x))) throw errno_error();
+}
 
-    if(setsockopt(_M_fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &imr, sizeof(imr))) throw errno_error();
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void socket::set_no_delay(bool x)
+{
+    set_option(IPPROTO_TCP, TCP_NODELAY, x ? 1 : 0);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
-void socket::drop_membership(net::address group)
+bool socket::no_delay() const
 {
-    ip_mreq imr;
-    imr.imr_multiaddr = group._M_addr;
-    imr.imr_interface = net::address::any._M_addr;
+    return get_option(IPPROTO_TCP, TCP_NODELAY);
+}
 
-    if(setsockopt(_M_fd, IPPROTO_IP, IP_DROP_MEMBERSHIP, &imr, sizeof(imr))) throw errno_error();
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void socket::set_cork(bool x)
+{
+    set_option(IPPROTO_TCP, TCP_CORK, x ? 1 : 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool socket::cork() const
+{
+    return get_option(IPPROTO_TCP, TCP_CORK);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void socket::set_quick_ack(bool x)
+{
+    set_option(IPPROTO_TCP, TCP_QUICKACK, x ? 1 : 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool socket::quick_ack() const
+{
+    return get_option(IPPROTO_TCP, TCP_QUICKACK);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void socket::set_multicast_loop(bool x)
+{
+    if(_M_family == net::family::v6)
+        set_option(IPPROTO_IPV6, IPV6_MULTICAST_LOOP, x ? 1 : 0);
+    else set_option(IPPROTO_IP, IP_MULTICAST_LOOP, x ? 1 : 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void socket::set_multicast_ttl(int x)
+{
+    if(_M_family == net::family::v6)
+        set_option(IPPROTO_IPV6, IPV6_MULTICAST_HOPS, x);
+    else set_option(IPPROTO_IP, IP_MULTICAST_TTL, x);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void socket::set_multicast_all(bool x)
+{
+#ifdef IPV6_MULTICAST_ALL
+    if(_M_family == net::family::v6)
+        set_option(IPPROTO_IPV6, IPV6_MULTICAST_ALL, x ? 1 : 0);
+    else
+#endif
+    set_option(IPPROTO_IP, IP_MULTICAST_ALL, x ? 1 : 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void socket::membership(net::address group, bool add)
+{
+    if(group.is_v6() && !group.is_v4_mapped())
+    {
+        ipv6_mreq imr;
+        imr.ipv6mr_multiaddr = group._M_v6;
+        imr.ipv6mr_interface = 0;
+
+        if(setsockopt(_M_fd, IPPROTO_IPV6, add ? IPV6_JOIN_GROUP : IPV6_LEAVE_GROUP, &imr, sizeof(imr)))
+            throw errno_error();
+    }
+    else
+    {
+        ip_mreq imr;
+        imr.imr_multiaddr = group.to_v4()._M_v4;
+        imr.imr_interface = net::address::any._M_v4;
+
+        if(setsockopt(_M_fd, IPPROTO_IP, add ? IP_ADD_MEMBERSHIP : IP_DROP_MEMBERSHIP, &imr, sizeof(imr)))
+            throw errno_error();
+    }
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 size_t socket::send_to(net::address address, net::port port, const void* buffer, size_t n, bool wait)
 {
-    sockaddr_in addr = from(address, port);
-    return base::send_to((sockaddr*)&addr, sizeof(addr), buffer, n, wait);
+    sockaddr_storage addr;
+    return base::send_to((sockaddr*)&addr, from(address, port, addr), buffer, n, wait);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t socket::send_to(net::address address, net::port port, const app::const_span* spans, size_t n, bool wait)
+{
+    sockaddr_storage addr;
+    return base::send_to((sockaddr*)&addr, from(address, port, addr), spans, n, wait);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 size_t socket::recv_from(net::address& address, net::port& port, std::string& string, size_t max, bool wait)
 {
-    std::unique_ptr<char[]> buffer(new char[max + 1]);
+    string.resize(max);
 
-    ssize_t count = recv_from(address, port, buffer.get(), max, wait);
-    buffer[count] = '\0';
+    size_t count = recv_from(address, port, &string[0], max, wait);
+    string.resize(count);
+
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t socket::recv_from(net::address& address, net::port& port, app::buffer& buffer, size_t max, bool wait)
+{
+    buffer.resize(max);
+
+    size_t count = recv_from(address, port, buffer.data(), max, wait);
+    buffer.resize(count);
 
-    string.assign(buffer.get(), count);
     return count;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 size_t socket::recv_from(net::address& address, net::port& port, void* buffer, size_t n, bool wait)
 {
-    sockaddr_in addr;
+    sockaddr_storage addr;
     socklen_t addr_len = sizeof(addr);
     memset(&addr, 0, addr_len);
 
     ssize_t count = base::recv_from((sockaddr*)&addr, addr_len, buffer, n, wait);
+    to(addr, address, port);
+
+    return count;
+}
 
-    if(addr.sin_family == AF_INET)
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t socket::recv_from(net::address& address, net::port& port, void* buffer, size_t n, time_point& time, bool wait)
+{
+    sockaddr_storage addr;
+    socklen_t addr_len = sizeof(addr);
+    memset(&addr, 0, addr_len);
+
+    ssize_t count = base::recv_from((sockaddr*)&addr, addr_len, buffer, n, time, wait);
+    to(addr, address, port);
+
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t socket::send_many(net::packet* packets, size_t n, bool wait)
+{
+    mmsghdr msgs[batch_max];
+    iovec iov[batch_max];
+    sockaddr_storage addr[batch_max];
+
+    size_t done = 0;
+    while(done < n)
     {
-        address._M_addr = addr.sin_addr;
-        port = ntohs(addr.sin_port);
+        size_t count = std::min(n - done, batch_max);
+        memset(msgs, 0, count * sizeof(mmsghdr));
+
+        for(size_t i = 0; i < count; ++i)
+        {
+            net::packet& packet = packets[done + i];
+            iov[i].iov_base = packet.buffer;
+            iov[i].iov_len = packet.size;
+
+            msgs[i].msg_hdr.msg_name = &addr[i];
+            msgs[i].msg_hdr.msg_namelen = from(packet.address, packet.port, addr[i]);
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        size_t sent = base::send_many(msgs, count, wait);
+        for(size_t i = 0; i < sent; ++i) packets[done + i].count = msgs[i].msg_len;
+
+        done += sent;
+        if(sent < count) break;
     }
 
-    return count;
+    return done;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t socket::recv_many(net::packet* packets, size_t n, bool wait)
+{
+    mmsghdr msgs[batch_max];
+    iovec iov[batch_max];
+    sockaddr_storage addr[batch_max];
+
+    size_t done = 0;
+    while(done < n)
+    {
+        size_t count = std::min(n - done, batch_max);
+        memset(msgs, 0, count * sizeof(mmsghdr));
+        memset(addr, 0, count * sizeof(sockaddr_storage));
+
+        for(size_t i = 0; i < count; ++i)
+        {
+            iov[i].iov_base = packets[done + i].buffer;
+            iov[i].iov_len = packets[done + i].size;
+
+            msgs[i].msg_hdr.msg_name = &addr[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(addr[i]);
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        // only the first batch may block
+        size_t recvd = base::recv_many(msgs, count, wait && done == 0);
+        for(size_t i = 0; i < recvd; ++i)
+        {
+            net::packet& packet = packets[done + i];
+            packet.count = msgs[i].msg_len;
+
+            to(addr[i], packet.address, packet.port);
+        }
+
+        done += recvd;
+        if(recvd < count) break;
+    }
+
+    return done;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -14,7 +14,9 @@
 #include "address.hpp"
 
 #include <string>
+#include <utility>
 #include <netinet/in.h>
+#include <sys/socket.h>
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 namespace net
@@ -24,6 +26,34 @@ namespace net
 typedef in_port_t port;
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
+/// \brief datagram descriptor for send_many/recv_many
+///
+struct packet
+{
+    packet() noexcept = default;
+
+    // receive into buffer
+    packet(void* buffer, size_t size) noexcept: buffer(buffer), size(size) { }
+
+    // send buffer to address:port
+    packet(net::address address, net::port port, const void* buffer, size_t size) noexcept:
+        address(address), port(port), buffer(const_cast<void*>(buffer)), size(size)
+    { }
+
+    net::address address;
+    net::port port = 0;
+
+    void* buffer = nullptr;
+    size_t size = 0;  //< buffer size
+    size_t count = 0; //< number of bytes sent or received
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// \brief IPv4 or IPv6 socket
+///
+/// Addresses received on IPv6 sockets are converted back to IPv4, if they are
+/// IPv4-mapped.
+///
 class socket: public app::socket
 {
 public:
@@ -35,7 +65,13 @@ public:
     socket(const socket&) = delete;
     socket(socket&& x) noexcept { swap(x); }
 
-    socket(type);
+    ////////////////////
+    /// \brief create socket
+    ///
+    /// IPv6 sockets are dual-stack: they also talk to IPv4 peers through
+    /// IPv4-mapped addresses (see set_v6_only).
+    ///
+    socket(type, net::family = net::family::v4);
 
     socket& operator=(const socket&) = delete;
     socket& operator=(socket&& x) noexcept
@@ -44,9 +80,27 @@ public:
         return (*this);
     }
 
+    void swap(socket& x) noexcept
+    {
+        base::swap(x);
+        std::swap(_M_family, x._M_family);
+    }
+
+    net::family family() const noexcept { return _M_family; }
+
+    ////////////////////
+    /// \brief restrict IPv6 socket to IPv6 peers (IPV6_V6ONLY)
+    ///
+    void set_v6_only(bool);
+
     void bind(net::address address, net::port port);
     void bind(net::port port) { bind(net::address::any, port); }
 
+    ////////////////////
+    /// \brief get address:port the socket is bound to (eg, the port picked by bind(0))
+    ///
+    void local_address(net::address& address, net::port& port) const;
+
     using app::socket::accept;
     void accept(net::socket& socket, net::address& address)
     {
@@ -55,24 +109,132 @@ public:
     }
     void accept(net::socket& socket, net::address& address, net::port& port);
 
+    ////////////////////
+    /// \brief accept connection (accept4)
+    /// \param wait block until there is a pending connection
+    /// \param non_block create accepted socket in non-blocking mode
+    /// \return false if wait is false and there is no pending connection
+    ///
+    /// The accepted socket is created close-on-exec.
+    ///
+    bool accept(net::socket& socket, net::address& address, net::port& port, bool wait, bool non_block = false);
+
     void connect(net::address address, net::port port);
 
+    ////////////////////
+    /// \brief connect with timeout
+    ///
+    /// Throws errno_error with std::errc::timed_out if the connection could not be
+    /// established in time.
+    ///
+    template<typename Rep, typename Period>
+    void connect(net::address address, net::port port, const std::chrono::duration<Rep, Period>& x)
+    {
+        std::chrono::seconds s = std::chrono::duration_cast<std::chrono::seconds>(x);
+        std::chrono::nanoseconds n = std::chrono::duration_cast<std::chrono::nanoseconds>(x - s);
+        connect(address, port, s, n);
+    }
+
+    ////////////////////
+    /// \brief start connecting without blocking
+    /// \return true if connected right away
+    ///
+    /// Puts the socket into non-blocking mode. Otherwise, wait for the socket to become
+    /// writable (eg, can_send or reactor) and call finish_connect.
+    ///
+    bool begin_connect(net::address address, net::port port);
+
+    ////////////////////
+    /// \brief allow several sockets to bind to the same address:port (SO_REUSEPORT)
+    ///
+    /// The kernel balances incoming connections (or datagrams) between them.
+    ///
+    void set_reuse_port(bool);
+
+    ////////////////////
+    /// \brief prefer connections handled by cpu (SO_INCOMING_CPU)
+    ///
+    void set_incoming_cpu(int cpu);
+
+    ////////////////////
+    /// \brief disable Nagle's algorithm (TCP_NODELAY)
+    ///
+    void set_no_delay(bool);
+    bool no_delay() const;
+
+    ////////////////////
+    /// \brief hold back partial frames until uncorked (TCP_CORK)
+    ///
+    void set_cork(bool);
+    bool cork() const;
+
+    ////////////////////
+    /// \brief send ACKs right away (TCP_QUICKACK)
+    ///
+    /// NB: this is not permanent, the kernel may switch back to delayed ACKs.
+    ///
+    void set_quick_ack(bool);
+    bool quick_ack() const;
+
     void set_multicast_loop(bool);
     void set_multicast_ttl(int);
     void set_multicast_all(bool);
 
-    void add_membership(net::address group);
-    void drop_membership(net::address group);
+    ////////////////////
+    /// \brief join/leave multicast group (IP_ADD_MEMBERSHIP or IPV6_JOIN_GROUP)
+    ///
+    void add_membership(net::address group) { membership(group, true); }
+    void drop_membership(net::address group) { membership(group, false); }
 
     size_t send_to(net::address address, net::port port, const std::string& string, bool wait = true)
         { return send_to(address, port, string.data(), string.size(), wait); }
     size_t send_to(net::address address, net::port port, const void* buffer, size_t n, bool wait = true);
 
+    size_t send_to(net::address address, net::port port, std::initializer_list<app::const_span> spans, bool wait = true)
+        { return send_to(address, port, spans.begin(), spans.size(), wait); }
+    size_t send_to(net::address address, net::port port, const app::const_span* spans, size_t n, bool wait = true);
+
     size_t recv_from(net::address& address, net::port& port, std::string& string, size_t max, bool wait = true);
+    size_t recv_from(net::address& address, net::port& port, app::buffer& buffer, size_t max, bool wait = true);
     size_t recv_from(net::address& address, net::port& port, void* buffer, size_t n, bool wait = true);
 
+    ////////////////////
+    /// \brief receive datagram along with its kernel receive timestamp
+    ///
+    /// Requires set_timestamp(true); otherwise time is set to epoch.
+    ///
+    size_t recv_from(net::address& address, net::port& port, void* buffer, size_t n, time_point& time, bool wait = true);
+
+    ////////////////////
+    /// \brief send several datagrams with as few syscalls as possible (sendmmsg)
+    /// \return number of packets sent
+    ///
+    size_t send_many(net::packet* packets, size_t n, bool wait = true);
+
+    ////////////////////
+    /// \brief receive several datagrams with as few syscalls as possible (recvmmsg)
+    /// \return number of packets received
+    ///
+    /// If wait is true, blocks until at least one datagram arrives.
+    ///
+    size_t recv_many(net::packet* packets, size_t n, bool wait = true);
+
+    template<typename Rep, typename Period>
+    size_t recv_many(net::packet* packets, size_t n, const std::chrono::duration<Rep, Period>& x)
+    {
+        return can_recv(x) ? recv_many(packets, n, false) : 0;
+    }
+
 private:
-    sockaddr_in from(net::address, net::port);
+    net::family _M_family = net::family::v4;
+
+    socklen_t from(net::address, net::port, sockaddr_storage&) const;
+    static void to(const sockaddr_storage&, net::address&, net::port&);
+
+    void membership(net::address group, bool add);
+
+    void connect(net::address, net::port, std::chrono::seconds, std::chrono::nanoseconds);
+
     using base = app::socket;
 };
 
@@ -0,0 +1,296 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2015 Dimitry Ishenko
+// Distributed under the GNU GPL v2. For full terms please visit:
+// http://www.gnu.org/licenses/gpl.html
+//
+// Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#include "errno_error.hpp"
+#include "resolver.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <utility>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace net
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+const std::error_category& resolver_category()
+{
+    static class resolver_category instance;
+    return instance;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+resolver::resolver(size_t threads, size_t max_size, std::chrono::seconds ttl, std::chrono::seconds negative_ttl, const std::string& hosts):
+    _M_max_size(max_size), _M_ttl(ttl), _M_negative_ttl(negative_ttl)
+{
+    if(hosts.size()) load_hosts(hosts);
+
+    if(threads == 0) threads = 1;
+    for(size_t n = 0; n < threads; ++n) _M_threads.emplace_back(&resolver::work, this);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+resolver::~resolver()
+{
+    std::unordered_map<std::string, std::vector<callback>> pending;
+    {
+        std::lock_guard<std::mutex> lock(_M_mutex);
+        _M_stop = true;
+
+        _M_queue.clear();
+        pending.swap(_M_pending);
+    }
+    _M_cond.notify_all();
+
+    for(auto& thread : _M_threads) thread.join();
+
+    std::error_code code = std::make_error_code(std::errc::operation_canceled);
+    for(auto& x : pending)
+        for(auto& fn : x.second) fn(code, addresses());
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+std::string resolver::normalize(const std::string& name)
+{
+    std::string x(name);
+    if(x.size() > 1 && x.back() == '.') x.pop_back();
+
+    std::transform(x.begin(), x.end(), x.begin(), [](unsigned char c) { return std::tolower(c); });
+    return x;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+std::error_code resolver::query(const std::string& name, addresses& result)
+{
+    addrinfo hints = { };
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo* info = nullptr;
+    int code = getaddrinfo(name.data(), nullptr, &hints, &info);
+    if(code == EAI_SYSTEM) return std::error_code(errno, std::generic_category());
+    if(code) return std::error_code(code, resolver_category());
+
+    for(addrinfo* ri = info; ri; ri = ri->ai_next)
+    {
+        net::address address;
+        if(ri->ai_family == AF_INET)
+            address = net::address(ntohl(reinterpret_cast<sockaddr_in*>(ri->ai_addr)->sin_addr.s_addr));
+        else if(ri->ai_family == AF_INET6)
+            address = net::address(reinterpret_cast<sockaddr_in6*>(ri->ai_addr)->sin6_addr);
+        else continue;
+
+        if(std::find(result.begin(), result.end(), address) == result.end()) result.push_back(address);
+    }
+    freeaddrinfo(info);
+
+    if(result.empty()) return net::resolver_errc::no_data;
+    return std::error_code();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void resolver::load_hosts(const std::string& path)
+{
+    std::ifstream stream(path);
+    if(!stream) throw errno_error("Failed to open " + path);
+
+    std::unordered_map<std::string, addresses> hosts;
+
+    std::string line;
+    while(std::getline(stream, line))
+    {
+        line.erase(std::min(line.find('#'), line.size()));
+
+        std::istringstream is(line);
+        std::string value, name;
+
+        net::address address;
+        if(!(is >> value) || net::from_chars(value.data(), value.data() + value.size(), address).ec != std::errc())
+            continue;
+
+        while(is >> name)
+        {
+            addresses& result = hosts[normalize(name)];
+            if(std::find(result.begin(), result.end(), address) == result.end()) result.push_back(address);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(_M_mutex);
+    _M_hosts.swap(hosts);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool resolver::find(const std::string& name, addresses& result, std::error_code& code)
+{
+    auto hi = _M_hosts.find(name);
+    if(hi != _M_hosts.end())
+    {
+        result = hi->second;
+        code.clear();
+        return true;
+    }
+
+    auto ri = _M_index.find(name);
+    if(ri == _M_index.end()) return false;
+
+    if(ri->second->expires <= clock::now())
+    {
+        _M_cache.erase(ri->second);
+        _M_index.erase(ri);
+        return false;
+    }
+
+    _M_cache.splice(_M_cache.begin(), _M_cache, ri->second);
+    result = ri->second->result;
+    code = ri->second->code;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void resolver::store(const std::string& name, const addresses& result, std::error_code code)
+{
+    if(_M_max_size == 0) return;
+
+    clock::duration ttl;
+    if(!code)
+        ttl = _M_ttl;
+    else if(code == net::resolver_errc::host_not_found || code == net::resolver_errc::no_data)
+        ttl = _M_negative_ttl;
+    else return; // transient
+
+    auto ri = _M_index.find(name);
+    if(ri != _M_index.end())
+    {
+        _M_cache.erase(ri->second);
+        _M_index.erase(ri);
+    }
+
+    _M_cache.push_front(entry { name, result, code, clock::now() + ttl });
+    _M_index[name] = _M_cache.begin();
+
+    while(_M_cache.size() > _M_max_size)
+    {
+        _M_index.erase(_M_cache.back().name);
+        _M_cache.pop_back();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool resolver::try_resolve(const std::string& name, addresses& result, std::error_code& code)
+{
+    net::address address;
+    if(net::from_chars(name.data(), name.data() + name.size(), address).ec == std::errc())
+    {
+        result.assign(1, address);
+        code.clear();
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(_M_mutex);
+    return find(normalize(name), result, code);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void resolver::resolve(const std::string& name, callback fn)
+{
+    addresses result;
+    std::error_code code;
+    if(try_resolve(name, result, code)) return fn(code, result);
+
+    std::string key = normalize(name);
+    {
+        std::lock_guard<std::mutex> lock(_M_mutex);
+
+        // may have been stored since try_resolve
+        if(!find(key, result, code))
+        {
+            auto& pending = _M_pending[key];
+            if(pending.empty()) _M_queue.push_back(key);
+
+            pending.push_back(std::move(fn));
+            _M_cond.notify_one();
+            return;
+        }
+    }
+    fn(code, result);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+std::future<resolver::addresses> resolver::resolve(const std::string& name)
+{
+    auto promise = std::make_shared<std::promise<addresses>>();
+    resolve(name, [promise](std::error_code code, const addresses& result)
+    {
+        if(code)
+            promise->set_exception(std::make_exception_ptr(errno_error(code)));
+        else promise->set_value(result);
+    });
+    return promise->get_future();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void resolver::clear()
+{
+    std::lock_guard<std::mutex> lock(_M_mutex);
+    _M_cache.clear();
+    _M_index.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t resolver::size()
+{
+    std::lock_guard<std::mutex> lock(_M_mutex);
+    return _M_cache.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void resolver::work()
+{
+    std::unique_lock<std::mutex> lock(_M_mutex);
+    for(;;)
+    {
+        _M_cond.wait(lock, [&]() { return _M_stop || _M_queue.size(); });
+        if(_M_stop) return;
+
+        std::string name = std::move(_M_queue.front());
+        _M_queue.pop_front();
+
+        lock.unlock();
+
+        addresses result;
+        std::error_code code = query(name, result);
+
+        lock.lock();
+        if(_M_stop) return; // callbacks are canceled by the destructor
+
+        store(name, result, code);
+
+        std::vector<callback> pending;
+        auto ri = _M_pending.find(name);
+        if(ri != _M_pending.end())
+        {
+            pending.swap(ri->second);
+            _M_pending.erase(ri);
+        }
+
+        lock.unlock();
+        for(auto& fn : pending) fn(code, result);
+        lock.lock();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+}
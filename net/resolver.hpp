@@ -0,0 +1,153 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2015 Dimitry Ishenko
+// Distributed under the GNU GPL v2. For full terms please visit:
+// http://www.gnu.org/licenses/gpl.html
+//
+// Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef RESOLVER_HPP
+#define RESOLVER_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#include "address.hpp"
+#include "resolver_error.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <list>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace net
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// \brief  asynchronous host name resolver
+///
+/// Names are looked up in this order: address literal, hosts file, cache and finally
+/// getaddrinfo on one of the worker threads. Concurrent queries for the same name are
+/// merged into one.
+///
+/// Successful results are cached for ttl and failed ones (host not found or no data)
+/// for negative_ttl. getaddrinfo does not report DNS record TTLs, so these are fixed.
+///
+class resolver
+{
+public:
+    typedef std::chrono::steady_clock clock;
+    typedef std::vector<net::address> addresses;
+
+    ////////////////////
+    /// \brief  resolve callback
+    ///
+    /// Called from the worker thread, or from resolve itself if the answer is known
+    /// right away. Must not throw.
+    ///
+    typedef std::function<void(std::error_code, const addresses&)> callback;
+
+public:
+    ////////////////////
+    /// \brief  construct resolver
+    /// \param  threads number of worker threads
+    /// \param  max_size max number of cached names (0 = no cache)
+    /// \param  ttl how long to cache successful results
+    /// \param  negative_ttl how long to cache failed results
+    /// \param  hosts hosts file to consult before getaddrinfo (empty = none)
+    ///
+    explicit resolver(size_t threads = 1, size_t max_size = 1024,
+        std::chrono::seconds ttl = std::chrono::seconds(300),
+        std::chrono::seconds negative_ttl = std::chrono::seconds(30),
+        const std::string& hosts = "/etc/hosts"
+    );
+    resolver(const resolver&) = delete;
+    resolver(resolver&&) = delete;
+
+    ////////////////////
+    /// \brief  destroy resolver
+    ///
+    /// Queries still waiting in the queue complete with std::errc::operation_canceled.
+    ///
+    ~resolver();
+
+    resolver& operator=(const resolver&) = delete;
+    resolver& operator=(resolver&&) = delete;
+
+    ////////////////////
+    /// \brief  resolve name and call fn with the result
+    ///
+    void resolve(const std::string& name, callback fn);
+
+    ////////////////////
+    /// \brief  resolve name
+    ///
+    /// The future throws errno_error holding the resolver error code on failure.
+    ///
+    std::future<addresses> resolve(const std::string& name);
+
+    ////////////////////
+    /// \brief  resolve name without querying
+    /// \return false if the answer is not known without calling getaddrinfo
+    ///
+    bool try_resolve(const std::string& name, addresses& result, std::error_code& code);
+
+    ////////////////////
+    /// \brief  (re)load hosts file
+    ///
+    /// Replaces previously loaded entries. Lines are "address name [alias...]"
+    /// and # starts a comment.
+    ///
+    void load_hosts(const std::string& path);
+
+    void clear();
+    size_t size();
+
+private:
+    struct entry
+    {
+        std::string name;
+        addresses result;
+        std::error_code code;
+        clock::time_point expires;
+    };
+
+    std::mutex _M_mutex;
+    std::condition_variable _M_cond;
+    bool _M_stop = false;
+
+    std::unordered_map<std::string, addresses> _M_hosts;
+
+    size_t _M_max_size;
+    clock::duration _M_ttl, _M_negative_ttl;
+
+    std::list<entry> _M_cache; // most recently used first
+    std::unordered_map<std::string, std::list<entry>::iterator> _M_index;
+
+    std::deque<std::string> _M_queue;
+    std::unordered_map<std::string, std::vector<callback>> _M_pending;
+
+    std::vector<std::thread> _M_threads;
+
+    static std::string normalize(const std::string&);
+    static std::error_code query(const std::string& name, addresses& result);
+
+    bool find(const std::string& name, addresses& result, std::error_code& code);
+    void store(const std::string& name, const addresses& result, std::error_code code);
+
+    void work();
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#endif // RESOLVER_HPP
@@ -0,0 +1,66 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2015 Dimitry Ishenko
+// Distributed under the GNU GPL v2. For full terms please visit:
+// http://www.gnu.org/licenses/gpl.html
+//
+// Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef RESOLVER_ERROR_HPP
+#define RESOLVER_ERROR_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#include <string>
+#include <system_error>
+
+#include <netdb.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace net
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// \brief  resolver (getaddrinfo) errors
+///
+enum class resolver_errc
+{
+    host_not_found  = EAI_NONAME,
+    no_data         = EAI_NODATA,
+    try_again       = EAI_AGAIN,
+    failure         = EAI_FAIL,
+    family          = EAI_FAMILY,
+    out_of_memory   = EAI_MEMORY,
+    system          = EAI_SYSTEM,
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+class resolver_category: public std::error_category
+{
+public:
+    const char* name() const noexcept override { return "resolver"; }
+    std::string message(int ev) const override { return gai_strerror(ev); }
+};
+
+const std::error_category& resolver_category();
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+inline std::error_code make_error_code(net::resolver_errc e)
+{ return std::error_code(static_cast<int>(e), resolver_category()); }
+
+inline std::error_condition make_error_condition(net::resolver_errc e)
+{ return std::error_condition(static_cast<int>(e), resolver_category()); }
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace std
+{
+    template<>
+    struct is_error_code_enum<net::resolver_errc>: public true_type { };
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#endif // RESOLVER_ERROR_HPP
@@ -10,12 +10,15 @@
 #include "errno_error.hpp"
 #include "process.hpp"
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
 
 #include <fcntl.h>
+#include <poll.h>
 #include <signal.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
@@ -208,6 +211,35 @@ static void handler(int)
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 bool process::can_join(std::chrono::seconds s, std::chrono::nanoseconds n)
 {
+#if defined(SYS_pidfd_open)
+    // pidfd becomes readable when the child exits;
+    // fall back to SIGCHLD if the kernel does not have it
+    if(running() && !_M_group)
+    {
+        int fd = syscall(SYS_pidfd_open, _M_id, 0);
+        if(fd != -1)
+        {
+            auto time = std::chrono::steady_clock::now() + s + n;
+            pollfd pfd = { fd, POLLIN, 0 };
+
+            int count;
+            for(;;)
+            {
+                auto left = std::max(std::chrono::nanoseconds(time - std::chrono::steady_clock::now()), std::chrono::nanoseconds(0));
+                auto ls = std::chrono::duration_cast<std::chrono::seconds>(left);
+                timespec wait = { static_cast<std::time_t>(ls.count()), static_cast<long>((left - ls).count()) };
+
+                count = ppoll(&pfd, 1, &wait, nullptr);
+                if(count != -1 || errno != EINTR) break;
+            }
+            ::close(fd);
+
+            if(count == -1) throw errno_error();
+            return !running();
+        }
+    }
+#endif
+
     if(running())
     {
         struct sigaction sa_old, sa_new;
@@ -0,0 +1,226 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2015 Dimitry Ishenko
+// Distributed under the GNU GPL v2. For full terms please visit:
+// http://www.gnu.org/licenses/gpl.html
+//
+// Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#include "errno_error.hpp"
+#include "reactor.hpp"
+
+#include <climits>
+#include <cstdint>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace app
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+reactor::reactor(): _M_events(64)
+{
+    _M_fd = epoll_create1(EPOLL_CLOEXEC);
+    if(_M_fd == invalid) throw errno_error();
+
+    _M_wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(_M_wake == invalid)
+    {
+        close();
+        throw errno_error();
+    }
+
+    epoll_event ev = { EPOLLIN, { } };
+    ev.data.fd = _M_wake;
+
+    if(epoll_ctl(_M_fd, EPOLL_CTL_ADD, _M_wake, &ev))
+    {
+        close();
+        throw errno_error();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void reactor::close() noexcept
+{
+    if(_M_wake != invalid)
+    {
+        ::close(_M_wake);
+        _M_wake = invalid;
+    }
+    if(_M_fd != invalid)
+    {
+        ::close(_M_fd);
+        _M_fd = invalid;
+    }
+
+    _M_handlers.clear();
+    _M_timers.clear();
+    _M_queue.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void reactor::add(int fd, app::event events, callback func)
+{
+    epoll_event ev = { static_cast<uint32_t>(events), { } };
+    ev.data.fd = fd;
+
+    if(epoll_ctl(_M_fd, EPOLL_CTL_ADD, fd, &ev)) throw errno_error();
+    _M_handlers[fd] = std::make_shared<callback>(std::move(func));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void reactor::modify(int fd, app::event events)
+{
+    epoll_event ev = { static_cast<uint32_t>(events), { } };
+    ev.data.fd = fd;
+
+    if(epoll_ctl(_M_fd, EPOLL_CTL_MOD, fd, &ev)) throw errno_error();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void reactor::remove(int fd)
+{
+    auto ri = _M_handlers.find(fd);
+    if(ri != _M_handlers.end())
+    {
+        _M_handlers.erase(ri);
+
+        // fd may already be closed, in which case epoll has dropped it
+        if(epoll_ctl(_M_fd, EPOLL_CTL_DEL, fd, nullptr) && errno != EBADF && errno != ENOENT)
+            throw errno_error();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+reactor::timer reactor::add_timer(std::chrono::nanoseconds n, timer_callback func, bool repeat)
+{
+    timer id = ++_M_next;
+    clock::time_point time = clock::now() + n;
+
+    _M_timers[id] = timer_entry { time, repeat ? n : std::chrono::nanoseconds(0), std::move(func) };
+    _M_queue.emplace(time, id);
+
+    return id;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool reactor::cancel(timer id) noexcept
+{
+    auto ri = _M_timers.find(id);
+    if(ri == _M_timers.end()) return false;
+
+    _M_queue.erase(std::make_pair(ri->second.time, id));
+    _M_timers.erase(ri);
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void reactor::run()
+{
+    // a stop() that came in before run() still counts
+    while(!_M_stop) run_once();
+    _M_stop = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void reactor::stop()
+{
+    _M_stop = true;
+
+    uint64_t value = 1;
+    if(::write(_M_wake, &value, sizeof(value)) == -1 && errno != EAGAIN) throw errno_error();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t reactor::run_for(std::chrono::seconds s, std::chrono::nanoseconds n)
+{
+    bool neg = s.count() < 0 || (s.count() == 0 && n.count() < 0);
+    std::chrono::nanoseconds wait = neg ? std::chrono::nanoseconds::max() : s + n;
+
+    if(!_M_queue.empty())
+    {
+        clock::duration left = _M_queue.begin()->first - clock::now();
+        if(left < wait) wait = std::max(std::chrono::duration_cast<std::chrono::nanoseconds>(left), std::chrono::nanoseconds(0));
+    }
+
+    // round up, so we don't wake before the timer is due
+    int msec = -1;
+    if(wait != std::chrono::nanoseconds::max())
+        msec = static_cast<int>(std::min<std::chrono::nanoseconds::rep>((wait.count() + 999999) / 1000000, INT_MAX));
+
+    int count = epoll_wait(_M_fd, _M_events.data(), _M_events.size(), msec);
+    if(count == -1)
+    {
+        if(errno == EINTR)
+            count = 0;
+        else throw errno_error();
+    }
+
+    size_t done = 0;
+    for(int i = 0; i < count; ++i)
+    {
+        const epoll_event& ev = _M_events[i];
+        if(ev.data.fd == _M_wake)
+        {
+            uint64_t value;
+            while(::read(_M_wake, &value, sizeof(value)) > 0);
+            continue;
+        }
+
+        auto ri = _M_handlers.find(ev.data.fd);
+        if(ri != _M_handlers.end())
+        {
+            // keep callback alive, in case it removes itself
+            std::shared_ptr<callback> func = ri->second;
+            (*func)(static_cast<app::event>(ev.events));
+            ++done;
+        }
+    }
+
+    if(count == static_cast<int>(_M_events.size())) _M_events.resize(2 * _M_events.size());
+
+    return done + run_timers();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t reactor::run_timers()
+{
+    size_t done = 0;
+    clock::time_point now = clock::now();
+
+    while(!_M_queue.empty() && _M_queue.begin()->first <= now)
+    {
+        timer id = _M_queue.begin()->second;
+        _M_queue.erase(_M_queue.begin());
+
+        auto ri = _M_timers.find(id);
+        if(ri == _M_timers.end()) continue;
+
+        timer_callback func;
+        if(ri->second.period.count())
+        {
+            ri->second.time += ri->second.period;
+            if(ri->second.time < now) ri->second.time = now + ri->second.period;
+
+            _M_queue.emplace(ri->second.time, id);
+            func = ri->second.func;
+        }
+        else
+        {
+            func = std::move(ri->second.func);
+            _M_timers.erase(ri);
+        }
+
+        func();
+        ++done;
+    }
+
+    return done;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+}
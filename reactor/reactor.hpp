@@ -0,0 +1,202 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2015 Dimitry Ishenko
+// Distributed under the GNU GPL v2. For full terms please visit:
+// http://www.gnu.org/licenses/gpl.html
+//
+// Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef REACTOR_HPP
+#define REACTOR_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#include "enum.hpp"
+#include "socket/socket.hpp"
+#include "storage/file.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <sys/epoll.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace app
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// \brief  reactor events
+///
+enum class event: uint32_t
+{
+    none   = 0,
+    read   = EPOLLIN,
+    write  = EPOLLOUT,
+    error  = EPOLLERR,
+    hangup = EPOLLHUP,
+
+    edge   = EPOLLET,      //< edge-triggered (default is level-triggered)
+    once   = EPOLLONESHOT, //< disable after one event (re-arm with modify)
+};
+DECLARE_OPERATOR(event)
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// \brief  epoll-based event loop
+///
+/// Dispatches readiness of any number of file descriptors (sockets, files, devices)
+/// and timers from a single thread. Unlike select, it has no FD_SETSIZE limit.
+///
+class reactor
+{
+public:
+    typedef int id;
+    static constexpr id invalid = -1;
+
+    typedef std::function<void(app::event)> callback;
+    typedef std::function<void()> timer_callback;
+
+    typedef unsigned long timer;
+    typedef std::chrono::steady_clock clock;
+
+public:
+    reactor();
+    reactor(const reactor&) = delete;
+    reactor(reactor&& x) noexcept { swap(x); }
+    ~reactor() { close(); }
+
+    void close() noexcept;
+    bool is_open() const noexcept { return _M_fd != invalid; }
+
+    reactor& operator=(const reactor&) = delete;
+    reactor& operator=(reactor&& x) noexcept
+    {
+        swap(x);
+        return (*this);
+    }
+
+    void swap(reactor& x) noexcept
+    {
+        std::swap(_M_fd, x._M_fd);
+        std::swap(_M_wake, x._M_wake);
+        _M_stop = x._M_stop.exchange(_M_stop);
+
+        std::swap(_M_handlers, x._M_handlers);
+        std::swap(_M_events, x._M_events);
+
+        std::swap(_M_timers, x._M_timers);
+        std::swap(_M_queue, x._M_queue);
+        std::swap(_M_next, x._M_next);
+    }
+
+    ////////////////////
+    /// \brief  register file descriptor
+    /// \param  fd file descriptor
+    /// \param  events events to watch for (error and hangup are always reported)
+    /// \param  func callback receiving the events that occurred
+    ///
+    void add(int fd, app::event events, callback func);
+    void add(const app::socket& x, app::event events, callback func) { add(x.get_id(), events, std::move(func)); }
+    void add(const storage::file& x, app::event events, callback func) { add(x.get_id(), events, std::move(func)); }
+
+    ////////////////////
+    /// \brief  change events of registered file descriptor
+    ///
+    void modify(int fd, app::event events);
+    void modify(const app::socket& x, app::event events) { modify(x.get_id(), events); }
+    void modify(const storage::file& x, app::event events) { modify(x.get_id(), events); }
+
+    ////////////////////
+    /// \brief  unregister file descriptor
+    ///
+    /// Safe to call from within a callback, including the callback being removed.
+    ///
+    void remove(int fd);
+    void remove(const app::socket& x) { remove(x.get_id()); }
+    void remove(const storage::file& x) { remove(x.get_id()); }
+
+    bool contains(int fd) const noexcept { return _M_handlers.count(fd); }
+    size_t size() const noexcept { return _M_handlers.size(); }
+
+    ////////////////////
+    /// \brief  add timer
+    /// \param  x timeout
+    /// \param  func callback
+    /// \param  repeat fire every x until cancelled
+    /// \return timer id
+    ///
+    template<typename Rep, typename Period>
+    timer add_timer(const std::chrono::duration<Rep, Period>& x, timer_callback func, bool repeat = false)
+    {
+        return add_timer(std::chrono::duration_cast<std::chrono::nanoseconds>(x), std::move(func), repeat);
+    }
+
+    ////////////////////
+    /// \brief  cancel timer
+    /// \return whether the timer was pending
+    ///
+    bool cancel(timer) noexcept;
+
+    ////////////////////
+    /// \brief  wait for and dispatch events and timers
+    /// \param  x timeout
+    /// \return number of callbacks invoked
+    ///
+    template<typename Rep, typename Period>
+    size_t run_for(const std::chrono::duration<Rep, Period>& x)
+    {
+        std::chrono::seconds s = std::chrono::duration_cast<std::chrono::seconds>(x);
+        std::chrono::nanoseconds n = std::chrono::duration_cast<std::chrono::nanoseconds>(x - s);
+        return run_for(s, n);
+    }
+
+    size_t run_once() { return run_for(std::chrono::seconds(-1)); }
+
+    ////////////////////
+    /// \brief  dispatch events and timers until stopped
+    ///
+    void run();
+
+    ////////////////////
+    /// \brief  stop running reactor
+    ///
+    /// Can be called from any thread or from within a callback. If the reactor
+    /// is not running, the next run() returns right away.
+    ///
+    void stop();
+
+protected:
+    id _M_fd = invalid;
+    id _M_wake = invalid;
+    std::atomic<bool> _M_stop { false };
+
+    std::unordered_map<int, std::shared_ptr<callback>> _M_handlers;
+    std::vector<epoll_event> _M_events;
+
+    struct timer_entry
+    {
+        clock::time_point time;
+        std::chrono::nanoseconds period;
+        timer_callback func;
+    };
+
+    std::unordered_map<timer, timer_entry> _M_timers;
+    std::set<std::pair<clock::time_point, timer>> _M_queue;
+    timer _M_next = 0;
+
+    timer add_timer(std::chrono::nanoseconds, timer_callback, bool repeat);
+
+    size_t run_for(std::chrono::seconds, std::chrono::nanoseconds);
+    size_t run_timers();
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#endif // REACTOR_HPP
@@ -0,0 +1,417 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2015 Dimitry Ishenko
+// Distributed under the GNU GPL v2. For full terms please visit:
+// http://www.gnu.org/licenses/gpl.html
+//
+// Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#include "errno_error.hpp"
+#include "ring.hpp"
+
+#include <memory>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace app
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+ring::ring(unsigned entries, unsigned threads)
+{
+#if defined(enable_io_uring)
+    // fall back to thread pool if the kernel says no
+    _M_uring = io_uring_queue_init(entries, &_M_ring, 0) == 0;
+#endif
+
+    if(!_M_uring)
+    {
+        // wakes up workers blocked on a socket when the ring is destroyed
+        _M_wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if(_M_wake == -1) throw errno_error();
+
+        try
+        {
+            if(threads == 0) threads = 1;
+            for(unsigned n = 0; n < threads; ++n) _M_threads.emplace_back(&ring::worker, this);
+        }
+        catch(...)
+        {
+            {
+                std::lock_guard<std::mutex> lock(_M_mutex);
+                _M_stop = true;
+            }
+            _M_work_cond.notify_all();
+            for(std::thread& thread : _M_threads) thread.join();
+
+            ::close(_M_wake);
+            throw;
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+ring::~ring()
+{
+#if defined(enable_io_uring)
+    if(_M_uring)
+    {
+        cancel();
+        io_uring_queue_exit(&_M_ring);
+    }
+#endif
+
+    if(_M_wake != -1)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_M_mutex);
+            _M_stop = true;
+        }
+        _M_work_cond.notify_all();
+
+        // never read, so it stays readable for every worker
+        uint64_t value = 1;
+        ssize_t count = ::write(_M_wake, &value, sizeof(value));
+        (void)count;
+
+        for(std::thread& thread : _M_threads) thread.join();
+        ::close(_M_wake);
+    }
+
+    auto discard = [](op* x)
+    {
+        // don't leak sockets accepted for nobody
+        if(x->code == op_accept && x->result >= 0) ::close(x->result);
+        delete x;
+    };
+
+    for(op* x : _M_queue) delete x;
+    for(op* x : _M_work) delete x;
+    for(op* x : _M_done) discard(x);
+    for(op* x : _M_ready) discard(x);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void ring::recv(app::socket& socket, void* buffer, size_t n, callback func)
+{
+    enqueue(op_recv, socket.get_id(), buffer, n, 0, nullptr, std::move(func));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void ring::send(app::socket& socket, const void* buffer, size_t n, callback func)
+{
+    enqueue(op_send, socket.get_id(), const_cast<void*>(buffer), n, 0, nullptr, std::move(func));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void ring::accept(app::socket& socket, app::socket& into, callback func)
+{
+    enqueue(op_accept, socket.get_id(), nullptr, 0, 0, &into, std::move(func));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void ring::read(storage::file& file, void* buffer, size_t n, storage::offset offset, callback func)
+{
+    enqueue(op_read, file.get_id(), buffer, n, offset, nullptr, std::move(func));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void ring::write(storage::file& file, const void* buffer, size_t n, storage::offset offset, callback func)
+{
+    enqueue(op_write, file.get_id(), const_cast<void*>(buffer), n, offset, nullptr, std::move(func));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void ring::enqueue(opcode code, int fd, void* buffer, size_t n, storage::offset offset, app::socket* into, callback func)
+{
+    std::unique_ptr<op> x(new op { code, fd, buffer, n, offset, into, std::move(func), 0, nullptr, nullptr });
+
+    _M_queue.push_back(x.get());
+    x.release();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t ring::submit()
+{
+    size_t count = _M_queue.size();
+    if(count == 0) return 0;
+
+#if defined(enable_io_uring)
+    if(_M_uring)
+    {
+        size_t done = 0;
+        try
+        {
+            for(; done < count; ++done)
+            {
+                op* x = _M_queue[done];
+
+                io_uring_sqe* sqe = io_uring_get_sqe(&_M_ring);
+                if(!sqe)
+                {
+                    // submission queue is full
+                    int code = io_uring_submit(&_M_ring);
+                    if(code < 0) throw errno_error(std::error_code(-code, std::generic_category()));
+
+                    sqe = io_uring_get_sqe(&_M_ring);
+                    if(!sqe) throw errno_error(std::make_error_code(std::errc::resource_unavailable_try_again));
+                }
+
+                switch(x->code)
+                {
+                case op_recv: io_uring_prep_recv(sqe, x->fd, x->buffer, x->n, 0); break;
+                case op_send: io_uring_prep_send(sqe, x->fd, x->buffer, x->n, MSG_NOSIGNAL); break;
+                case op_accept: io_uring_prep_accept(sqe, x->fd, nullptr, nullptr, SOCK_CLOEXEC); break;
+                case op_read: io_uring_prep_read(sqe, x->fd, x->buffer, x->n, x->offset); break;
+                case op_write: io_uring_prep_write(sqe, x->fd, x->buffer, x->n, x->offset); break;
+                }
+                io_uring_sqe_set_data(sqe, x);
+
+                link(x);
+                ++_M_pending;
+            }
+        }
+        catch(...)
+        {
+            // prepared ops belong to the kernel now
+            _M_queue.erase(_M_queue.begin(), _M_queue.begin() + done);
+            throw;
+        }
+        _M_queue.clear();
+
+        int code = io_uring_submit(&_M_ring);
+        if(code < 0) throw errno_error(std::error_code(-code, std::generic_category()));
+
+        return done;
+    }
+#endif
+
+    {
+        std::lock_guard<std::mutex> lock(_M_mutex);
+        _M_work.insert(_M_work.end(), _M_queue.begin(), _M_queue.end());
+    }
+    _M_queue.clear();
+    _M_pending += count;
+
+    _M_work_cond.notify_all();
+    return count;
+}
+
+#if defined(enable_io_uring)
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void ring::link(op* x) noexcept
+{
+    x->prev = nullptr;
+    x->next = _M_flight;
+    if(_M_flight) _M_flight->prev = x;
+    _M_flight = x;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void ring::unlink(op* x) noexcept
+{
+    if(x->prev) x->prev->next = x->next; else _M_flight = x->next;
+    if(x->next) x->next->prev = x->prev;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void ring::cancel() noexcept
+{
+    // the kernel may still write into (freed) buffers or accept connections,
+    // so cancel everything in flight and wait for it to come back
+    for(op* x = _M_flight; x; x = x->next)
+    {
+        io_uring_sqe* sqe = io_uring_get_sqe(&_M_ring);
+        if(!sqe)
+        {
+            io_uring_submit(&_M_ring);
+            sqe = io_uring_get_sqe(&_M_ring);
+            if(!sqe) break;
+        }
+        io_uring_prep_cancel(sqe, x, 0);
+        io_uring_sqe_set_data(sqe, nullptr);
+    }
+    io_uring_submit(&_M_ring);
+
+    while(_M_flight)
+    {
+        io_uring_cqe* cqe;
+        int code = io_uring_wait_cqe(&_M_ring, &cqe);
+        if(code == -EINTR) continue;
+        if(code < 0) break;
+
+        op* x = static_cast<op*>(io_uring_cqe_get_data(cqe));
+        if(x)
+        {
+            unlink(x);
+            x->result = cqe->res;
+            _M_ready.push_back(x);
+        }
+        io_uring_cqe_seen(&_M_ring, cqe);
+    }
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+int ring::wait(int fd, short events) noexcept
+{
+    pollfd fds[] = { { fd, events, 0 }, { _M_wake, POLLIN, 0 } };
+    for(;;)
+    {
+        if(::poll(fds, 2, -1) == -1)
+        {
+            if(errno == EINTR) continue;
+            return -errno;
+        }
+        // ring is being destroyed
+        if(fds[1].revents) return -ECANCELED;
+
+        // ready or failed, the call itself will report which
+        return 0;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void ring::execute(op* x) noexcept
+{
+    // socket calls wait in poll (rather than block), so that the destructor can wake them up
+    ssize_t n;
+    for(;;)
+    {
+        int code = 0;
+        switch(x->code)
+        {
+        case op_recv: case op_accept: code = wait(x->fd, POLLIN); break;
+        case op_send: code = wait(x->fd, POLLOUT); break;
+        default: break;
+        }
+        if(code)
+        {
+            x->result = code;
+            return;
+        }
+
+        switch(x->code)
+        {
+        case op_recv: n = ::recv(x->fd, x->buffer, x->n, MSG_DONTWAIT); break;
+        case op_send: n = ::send(x->fd, x->buffer, x->n, MSG_DONTWAIT | MSG_NOSIGNAL); break;
+        // NB: a blocking listening socket can still block here,
+        // if another thread takes the connection after poll
+        case op_accept: n = ::accept4(x->fd, nullptr, nullptr, SOCK_CLOEXEC); break;
+        case op_read: n = ::pread(x->fd, x->buffer, x->n, x->offset); break;
+        case op_write: n = ::pwrite(x->fd, x->buffer, x->n, x->offset); break;
+        default: n = -1; errno = EINVAL;
+        }
+
+        if(n != -1 || (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK)) break;
+    }
+
+    x->result = n == -1 ? -errno : n;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void ring::worker()
+{
+    std::unique_lock<std::mutex> lock(_M_mutex);
+    for(;;)
+    {
+        _M_work_cond.wait(lock, [this]() { return _M_stop || !_M_work.empty(); });
+        if(_M_stop) break;
+
+        op* x = _M_work.front();
+        _M_work.pop_front();
+
+        lock.unlock();
+        execute(x);
+        lock.lock();
+
+        _M_done.push_back(x);
+        _M_done_cond.notify_one();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t ring::harvest(std::chrono::seconds s, std::chrono::nanoseconds n)
+{
+    // leftovers from a callback that threw
+    if(!_M_ready.empty()) return complete();
+    if(_M_pending == 0) return 0;
+
+    bool neg = s.count() < 0 || (s.count() == 0 && n.count() < 0);
+
+#if defined(enable_io_uring)
+    if(_M_uring)
+    {
+        io_uring_cqe* cqe;
+        int code;
+        if(neg)
+            code = io_uring_wait_cqe(&_M_ring, &cqe);
+        else
+        {
+            __kernel_timespec time = { s.count(), n.count() };
+            code = io_uring_wait_cqe_timeout(&_M_ring, &cqe, &time);
+        }
+
+        if(code == -ETIME || code == -EINTR || code == -EAGAIN) return 0;
+        if(code < 0) throw errno_error(std::error_code(-code, std::generic_category()));
+
+        unsigned head, count = 0;
+        io_uring_for_each_cqe(&_M_ring, head, cqe)
+        {
+            op* x = static_cast<op*>(io_uring_cqe_get_data(cqe));
+            unlink(x);
+            x->result = cqe->res;
+
+            _M_ready.push_back(x);
+            ++count;
+        }
+        io_uring_cq_advance(&_M_ring, count);
+
+        return complete();
+    }
+#endif
+
+    {
+        std::unique_lock<std::mutex> lock(_M_mutex);
+        auto ready = [this]() { return !_M_done.empty(); };
+
+        if(neg)
+            _M_done_cond.wait(lock, ready);
+        else if(!_M_done_cond.wait_for(lock, s + n, ready))
+            return 0;
+
+        _M_ready.insert(_M_ready.end(), _M_done.begin(), _M_done.end());
+        _M_done.clear();
+    }
+
+    return complete();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t ring::complete()
+{
+    size_t count = 0;
+    while(!_M_ready.empty())
+    {
+        std::unique_ptr<op> x(_M_ready.front());
+        _M_ready.pop_front();
+        --_M_pending;
+
+        if(x->code == op_accept && x->result >= 0)
+        {
+            x->into->close();
+            x->into->_M_fd = x->result;
+        }
+
+        if(x->func) x->func(x->result);
+        ++count;
+    }
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+}
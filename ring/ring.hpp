@@ -0,0 +1,189 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2015 Dimitry Ishenko
+// Distributed under the GNU GPL v2. For full terms please visit:
+// http://www.gnu.org/licenses/gpl.html
+//
+// Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef RING_HPP
+#define RING_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#include "socket/socket.hpp"
+#include "storage/file.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <sys/types.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// The io_uring backend is opt-in: define enable_io_uring (eg, add -Denable_io_uring to DEFINES
+/// and -luring to LIBRARIES). It is disabled again if liburing.h cannot be found. Without it,
+/// or if the kernel does not support io_uring, operations run on a pool of worker threads
+/// using regular blocking calls.
+///
+#if defined(enable_io_uring) && defined(__has_include)
+#  if !__has_include(<liburing.h>)
+#    undef enable_io_uring
+#  endif
+#endif
+
+#if defined(enable_io_uring)
+#  include <liburing.h>
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace app
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// \brief  asynchronous I/O submission ring
+///
+/// Operations are queued with recv/send/accept/read/write, handed to the kernel (or thread pool)
+/// in batches by submit() and their callbacks are run by harvest(), on the harvesting thread.
+///
+/// Buffers must remain valid until the operation completes. Operations still pending when the
+/// ring is destroyed are cancelled and their callbacks are not run.
+///
+class ring
+{
+public:
+    ////////////////////
+    /// \brief  completion callback
+    ///
+    /// Receives number of bytes transferred (or accepted socket id) on success,
+    /// or negated errno value on failure.
+    ///
+    typedef std::function<void(ssize_t)> callback;
+
+public:
+    ////////////////////
+    /// \brief  construct ring
+    /// \param  entries submission queue size
+    /// \param  threads number of worker threads (fallback backend only)
+    ///
+    explicit ring(unsigned entries = 256, unsigned threads = 4);
+    ring(const ring&) = delete;
+    ring(ring&&) = delete;
+    ~ring();
+
+    ring& operator=(const ring&) = delete;
+    ring& operator=(ring&&) = delete;
+
+    ////////////////////
+    /// \brief  check if the io_uring backend is in use
+    ///
+    bool is_uring() const noexcept { return _M_uring; }
+
+    void recv(app::socket& socket, void* buffer, size_t n, callback func);
+    void send(app::socket& socket, const void* buffer, size_t n, callback func);
+
+    ////////////////////
+    /// \brief  accept connection
+    /// \param  socket listening socket
+    /// \param  into socket receiving the new connection
+    /// \param  func callback
+    ///
+    void accept(app::socket& socket, app::socket& into, callback func);
+
+    void read(storage::file& file, void* buffer, size_t n, storage::offset offset, callback func);
+    void write(storage::file& file, const void* buffer, size_t n, storage::offset offset, callback func);
+
+    ////////////////////
+    /// \brief  submit queued operations
+    /// \return number of operations submitted
+    ///
+    size_t submit();
+
+    ////////////////////
+    /// \brief  wait for completions and run their callbacks
+    /// \param  x timeout (for the first completion)
+    /// \return number of callbacks run
+    ///
+    template<typename Rep, typename Period>
+    size_t harvest(const std::chrono::duration<Rep, Period>& x)
+    {
+        std::chrono::seconds s = std::chrono::duration_cast<std::chrono::seconds>(x);
+        std::chrono::nanoseconds n = std::chrono::duration_cast<std::chrono::nanoseconds>(x - s);
+        return harvest(s, n);
+    }
+
+    size_t harvest() { return harvest(std::chrono::seconds(-1)); }
+
+    ////////////////////
+    /// \brief  number of submitted operations that have not been harvested yet
+    ///
+    size_t pending() const noexcept { return _M_pending; }
+
+protected:
+    enum opcode { op_recv, op_send, op_accept, op_read, op_write };
+
+    struct op
+    {
+        opcode code;
+        int fd;
+        void* buffer;
+        size_t n;
+        storage::offset offset;
+
+        app::socket* into;
+        callback func;
+
+        ssize_t result;
+
+        // in-flight list (io_uring backend)
+        op* prev;
+        op* next;
+    };
+
+    bool _M_uring = false;
+    size_t _M_pending = 0;
+
+    // operations queued since last submit
+    std::vector<op*> _M_queue;
+
+    // fallback thread pool
+    std::vector<std::thread> _M_threads;
+    std::mutex _M_mutex;
+    std::condition_variable _M_work_cond, _M_done_cond;
+    std::deque<op*> _M_work, _M_done;
+    bool _M_stop = false;
+    int _M_wake = -1;
+
+    // harvested, but callbacks not run yet
+    std::deque<op*> _M_ready;
+
+#if defined(enable_io_uring)
+    io_uring _M_ring;
+
+    // submitted to the kernel, but not harvested yet
+    op* _M_flight = nullptr;
+
+    void link(op*) noexcept;
+    void unlink(op*) noexcept;
+    void cancel() noexcept;
+#endif
+
+    void enqueue(opcode, int fd, void* buffer, size_t n, storage::offset, app::socket* into, callback);
+    void execute(op*) noexcept;
+    int wait(int fd, short events) noexcept;
+    void worker();
+
+    size_t harvest(std::chrono::seconds, std::chrono::nanoseconds);
+    size_t complete();
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#endif // RING_HPP
@@ -0,0 +1,374 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2015 Dimitry Ishenko
+// Distributed under the GNU GPL v2. For full terms please visit:
+// http://www.gnu.org/licenses/gpl.html
+//
+// Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#include "errno_error.hpp"
+#include "shm_channel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <system_error>
+
+#include <linux/futex.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace shm
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+constexpr size_t channel::record_header;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// Shared memory layout: header (one page) followed by the ring.
+///
+/// Each message is a record of a 64-bit header and the payload padded to 8 bytes.
+/// The record header holds the payload length and the ready bit, which the sender sets
+/// last. A record that does not fit before the end of the ring is preceded by a padding
+/// record covering the rest. The receiver zeroes records it has consumed, so that any
+/// 8-byte slot in the free part of the ring reads as "not ready".
+///
+struct channel::header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size;
+
+    alignas(64) std::atomic<uint64_t> tail; // reserved by senders
+    alignas(64) std::atomic<uint64_t> head; // consumed by receiver
+
+    std::atomic<uint32_t> space;   // futex bumped when space frees up with senders waiting
+    std::atomic<uint32_t> senders; // number of waiting senders
+
+    alignas(64) std::atomic<uint32_t> receiver; // receiver wants eventfd signal
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace
+{
+
+constexpr uint32_t magic = 0x73686d63; // shmc
+constexpr uint32_t version = 1;
+
+constexpr size_t header_size = 4096;
+
+constexpr uint64_t ready = uint64_t(1) << 32;
+constexpr uint64_t padding = uint64_t(1) << 33;
+constexpr uint64_t length_mask = 0xffffffff;
+
+inline size_t align(size_t n) { return (n + 7) & ~size_t(7); }
+
+inline std::atomic<uint64_t>* record(char* ring, uint64_t offset)
+{
+    return reinterpret_cast<std::atomic<uint64_t>*>(ring + offset);
+}
+
+inline void futex_wait(std::atomic<uint32_t>* x, uint32_t value)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(x), FUTEX_WAIT, value, nullptr, nullptr, 0);
+}
+
+inline void futex_wake(std::atomic<uint32_t>* x)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(x), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+channel::channel(size_t capacity)
+{
+    // record lengths are 32-bit
+    if(capacity > (uint64_t(1) << 32)) throw errno_error(std::make_error_code(std::errc::invalid_argument));
+
+    size_t size = 4096;
+    while(size < capacity) size <<= 1;
+
+    try
+    {
+        _M_mem = memfd_create("shm::channel", MFD_CLOEXEC);
+        if(_M_mem == invalid) throw errno_error();
+
+        if(ftruncate(_M_mem, header_size + size)) throw errno_error();
+
+        _M_event = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if(_M_event == invalid) throw errno_error();
+
+        map(header_size + size);
+
+        _M_header->magic = magic;
+        _M_header->version = version;
+        _M_header->size = size;
+        _M_size = size;
+    }
+    catch(...)
+    {
+        close();
+        throw;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+channel::channel(unix::socket& socket)
+{
+    int fds[2];
+    size_t n = 2;
+    socket.recv_fds(fds, n);
+
+    if(n < 2)
+    {
+        if(n) ::close(fds[0]);
+        throw errno_error(std::make_error_code(std::errc::bad_message));
+    }
+    _M_mem = fds[0];
+    _M_event = fds[1];
+
+    try
+    {
+        struct stat st;
+        if(fstat(_M_mem, &st)) throw errno_error();
+
+        size_t total = st.st_size;
+        if(total < header_size) throw errno_error(std::make_error_code(std::errc::bad_message));
+
+        map(total);
+
+        if(_M_header->magic != magic || _M_header->version != version || _M_header->size != total - header_size)
+            throw errno_error(std::make_error_code(std::errc::bad_message));
+        _M_size = _M_header->size;
+    }
+    catch(...)
+    {
+        close();
+        throw;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void channel::map(size_t total)
+{
+    void* data = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, _M_mem, 0);
+    if(data == MAP_FAILED) throw errno_error();
+
+    _M_header = static_cast<header*>(data);
+    _M_ring = static_cast<char*>(data) + header_size;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void channel::close() noexcept
+{
+    if(_M_header)
+    {
+        munmap(_M_header, header_size + _M_size);
+        _M_header = nullptr;
+        _M_ring = nullptr;
+        _M_size = 0;
+    }
+    if(_M_event != invalid)
+    {
+        ::close(_M_event);
+        _M_event = invalid;
+    }
+    if(_M_mem != invalid)
+    {
+        ::close(_M_mem);
+        _M_mem = invalid;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void channel::share(unix::socket& socket)
+{
+    socket.send_fds({ _M_mem, _M_event });
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t channel::send(const void* buffer, size_t n, bool wait)
+{
+    if(n > max_size()) throw errno_error(std::make_error_code(std::errc::message_size));
+
+    uint64_t size = record_header + align(n);
+
+    for(;;)
+    {
+        // load head before tail, so that tail - head never underflows
+        uint64_t head = _M_header->head.load(std::memory_order_acquire);
+        uint64_t tail = _M_header->tail.load(std::memory_order_acquire);
+
+        uint64_t offset = tail & (_M_size - 1);
+        uint64_t pad = offset + size > _M_size ? _M_size - offset : 0;
+
+        if(tail + pad + size - head <= _M_size)
+        {
+            if(!_M_header->tail.compare_exchange_weak(tail, tail + pad + size, std::memory_order_relaxed))
+                continue;
+
+            if(pad)
+            {
+                record(_M_ring, offset)->store(ready | padding | pad, std::memory_order_release);
+                offset = 0;
+            }
+            memcpy(_M_ring + offset + record_header, buffer, n);
+
+            // seq_cst pairs with the receiver setting its flag and re-checking
+            record(_M_ring, offset)->store(ready | n, std::memory_order_seq_cst);
+            if(_M_header->receiver.load(std::memory_order_seq_cst))
+            {
+                uint64_t value = 1;
+                ssize_t count = ::write(_M_event, &value, sizeof(value));
+                (void)count;
+            }
+
+            return n;
+        }
+
+        if(!wait) return 0;
+
+        // ring is full
+        uint32_t space = _M_header->space.load(std::memory_order_acquire);
+        _M_header->senders.fetch_add(1, std::memory_order_seq_cst);
+
+        head = _M_header->head.load(std::memory_order_seq_cst);
+        tail = _M_header->tail.load(std::memory_order_seq_cst);
+        offset = tail & (_M_size - 1);
+        pad = offset + size > _M_size ? _M_size - offset : 0;
+
+        if(tail + pad + size - head > _M_size)
+            futex_wait(&_M_header->space, space);
+
+        _M_header->senders.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool channel::pending() const noexcept
+{
+    uint64_t head = _M_header->head.load(std::memory_order_relaxed);
+    return record(_M_ring, head & (_M_size - 1))->load(std::memory_order_seq_cst) & ready;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool channel::try_recv(void* buffer, size_t max, size_t& count)
+{
+    uint64_t head = _M_header->head.load(std::memory_order_relaxed);
+    for(;;)
+    {
+        uint64_t offset = head & (_M_size - 1);
+        std::atomic<uint64_t>* rec = record(_M_ring, offset);
+
+        uint64_t value = rec->load(std::memory_order_acquire);
+        if(!(value & ready))
+        {
+            // reset eventfd, ask senders to signal, then re-check; anything
+            // sent after the re-check makes the eventfd readable again
+            uint64_t event;
+            ssize_t n = ::read(_M_event, &event, sizeof(event));
+            (void)n;
+
+            _M_header->receiver.store(1, std::memory_order_seq_cst);
+            if(rec->load(std::memory_order_seq_cst) & ready) continue;
+
+            return false;
+        }
+
+        uint64_t size;
+        if(value & padding)
+        {
+            size = value & length_mask;
+            count = 0;
+        }
+        else
+        {
+            size = record_header + align(value & length_mask);
+            count = std::min<size_t>(value & length_mask, max);
+            memcpy(buffer, _M_ring + offset + record_header, count);
+        }
+
+        memset(_M_ring + offset, 0, size);
+        head += size;
+
+        // seq_cst pairs with senders going to sleep
+        _M_header->head.store(head, std::memory_order_seq_cst);
+        if(_M_header->senders.load(std::memory_order_seq_cst))
+        {
+            _M_header->space.fetch_add(1, std::memory_order_release);
+            futex_wake(&_M_header->space);
+        }
+
+        if(!(value & padding))
+        {
+            if(_M_header->receiver.load(std::memory_order_relaxed))
+                _M_header->receiver.store(0, std::memory_order_relaxed);
+            return true;
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool channel::can_recv(std::chrono::seconds s, std::chrono::nanoseconds n)
+{
+    if(pending()) return true;
+
+    _M_header->receiver.store(1, std::memory_order_seq_cst);
+    if(pending()) return true;
+
+    timespec time = { static_cast<std::time_t>(s.count()), static_cast<long>(n.count()) };
+    pollfd fd = { _M_event, POLLIN, 0 };
+
+    if(ppoll(&fd, 1, s.count() < 0 ? nullptr : &time, nullptr) == -1 && errno != EINTR) throw errno_error();
+
+    uint64_t value;
+    ssize_t count = ::read(_M_event, &value, sizeof(value)); // reset
+    (void)count;
+
+    return pending();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t channel::recv(void* buffer, size_t max, bool wait)
+{
+    size_t count = 0;
+    while(!try_recv(buffer, max, count))
+    {
+        if(!wait) return 0;
+        can_recv(std::chrono::seconds(-1), std::chrono::nanoseconds(0));
+    }
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t channel::recv(std::string& string, size_t max, bool wait)
+{
+    string.resize(max);
+
+    size_t count = recv(&string[0], max, wait);
+    string.resize(count);
+
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t channel::recv(app::buffer& buffer, size_t max, bool wait)
+{
+    buffer.resize(max);
+
+    size_t count = recv(buffer.data(), max, wait);
+    buffer.resize(count);
+
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+}
@@ -0,0 +1,163 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2015 Dimitry Ishenko
+// Distributed under the GNU GPL v2. For full terms please visit:
+// http://www.gnu.org/licenses/gpl.html
+//
+// Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef SHM_CHANNEL_HPP
+#define SHM_CHANNEL_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#include "buffer.hpp"
+#include "unix/unix_socket.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace shm
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// \brief  shared memory message channel
+///
+/// Lock-free ring of messages in a memfd_create mapping, shared between processes by
+/// passing its descriptors over a unix socket. Any number of processes may send, but
+/// only one may receive.
+///
+/// Messages are copied straight into and out of the shared ring; there are no
+/// syscalls unless one side has to wait. A blocked receiver is woken through an
+/// eventfd (which can also be watched with a reactor, see get_id) and blocked
+/// senders through a futex in the shared memory.
+///
+class channel
+{
+public:
+    typedef int id;
+    static constexpr id invalid = -1;
+
+public:
+    channel() noexcept = default;
+    channel(const channel&) = delete;
+    channel(channel&& x) noexcept { swap(x); }
+
+    ////////////////////
+    /// \brief  create channel
+    /// \param  capacity ring size in bytes (rounded up to a power of 2)
+    ///
+    explicit channel(size_t capacity);
+
+    ////////////////////
+    /// \brief  attach to channel shared by the peer
+    ///
+    /// Receives the channel descriptors sent by share().
+    ///
+    explicit channel(unix::socket& socket);
+
+    ~channel() { close(); }
+
+    void close() noexcept;
+    bool is_open() const noexcept { return _M_header != nullptr; }
+
+    channel& operator=(const channel&) = delete;
+    channel& operator=(channel&& x) noexcept
+    {
+        swap(x);
+        return (*this);
+    }
+
+    void swap(channel& x) noexcept
+    {
+        std::swap(_M_mem, x._M_mem);
+        std::swap(_M_event, x._M_event);
+        std::swap(_M_header, x._M_header);
+        std::swap(_M_ring, x._M_ring);
+        std::swap(_M_size, x._M_size);
+    }
+
+    ////////////////////
+    /// \brief  send channel descriptors to the peer
+    ///
+    void share(unix::socket& socket);
+
+    size_t capacity() const noexcept { return _M_size; }
+
+    ////////////////////
+    /// \brief  largest message that fits
+    ///
+    size_t max_size() const noexcept { return _M_size / 2 - record_header; }
+
+    ////////////////////
+    /// \brief  send message
+    /// \param  wait block while the ring is full
+    /// \return n, or 0 if wait is false and the ring is full
+    ///
+    /// Throws errno_error with std::errc::message_size if n > max_size().
+    ///
+    size_t send(const std::string& string, bool wait = true)
+        { return send(string.data(), string.size(), wait); }
+    size_t send(const void* buffer, size_t n, bool wait = true);
+
+    ////////////////////
+    /// \brief  receive message
+    /// \param  wait block until a message arrives
+    /// \return message size, or 0 if wait is false and there are no messages
+    ///
+    /// As with datagram sockets, a message longer than max is truncated.
+    ///
+    size_t recv(std::string& string, size_t max, bool wait = true);
+    size_t recv(app::buffer& buffer, size_t max, bool wait = true);
+    size_t recv(void* buffer, size_t max, bool wait = true);
+
+    ////////////////////
+    /// \brief  wait for message
+    ///
+    /// Negative duration means wait forever.
+    ///
+    template<typename Rep, typename Period>
+    bool can_recv(const std::chrono::duration<Rep, Period>& x)
+    {
+        std::chrono::seconds s = std::chrono::duration_cast<std::chrono::seconds>(x);
+        std::chrono::nanoseconds n = std::chrono::duration_cast<std::chrono::nanoseconds>(x - s);
+        return can_recv(s, n);
+    }
+
+    ////////////////////
+    /// \brief  receiver eventfd
+    ///
+    /// Becomes readable when a message is sent after recv or can_recv found the ring
+    /// empty, and is reset when they find it empty again. So, with a reactor, receive
+    /// until recv(..., false) returns 0 and go back to the loop; the eventfd stays quiet
+    /// until the next message.
+    ///
+    channel::id get_id() const noexcept { return _M_event; }
+
+protected:
+    struct header;
+    static constexpr size_t record_header = sizeof(uint64_t);
+
+    id _M_mem = invalid;
+    id _M_event = invalid;
+
+    header* _M_header = nullptr;
+    char* _M_ring = nullptr;
+    size_t _M_size = 0;
+
+    void map(size_t total);
+
+    bool can_recv(std::chrono::seconds, std::chrono::nanoseconds);
+
+    bool pending() const noexcept;
+    bool try_recv(void* buffer, size_t max, size_t& count);
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#endif // SHM_CHANNEL_HPP
@@ -0,0 +1,286 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2015 Dimitry Ishenko
+// Distributed under the GNU GPL v2. For full terms please visit:
+// http://www.gnu.org/licenses/gpl.html
+//
+// Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#include "errno_error.hpp"
+#include "framer.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <system_error>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace app
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+framer::framer(app::socket& socket, app::prefix prefix, size_t max_frame):
+    _M_socket(socket), _M_prefix(prefix), _M_max_frame(max_frame)
+{
+    if((prefix == app::prefix::fixed16 && max_frame > UINT16_MAX)
+    || (prefix == app::prefix::fixed32 && max_frame > UINT32_MAX))
+        throw errno_error(std::make_error_code(std::errc::invalid_argument));
+
+    // large enough for the largest frame, so a full ring always holds a complete one
+    _M_ring.resize(max_frame + max_prefix);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t framer::encode(size_t n, char* prefix) const
+{
+    switch(_M_prefix)
+    {
+    case app::prefix::varint:
+        {
+            size_t size = 0;
+            do
+            {
+                unsigned char c = n & 0x7f;
+                n >>= 7;
+                if(n) c |= 0x80;
+
+                prefix[size++] = c;
+            }
+            while(n);
+            return size;
+        }
+
+    case app::prefix::fixed16:
+        prefix[0] = n >> 8;
+        prefix[1] = n;
+        return 2;
+
+    case app::prefix::fixed32:
+        prefix[0] = n >> 24;
+        prefix[1] = n >> 16;
+        prefix[2] = n >> 8;
+        prefix[3] = n;
+        return 4;
+    }
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool framer::decode(const char* prefix, size_t size, size_t& n, size_t& length) const
+{
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(prefix);
+    uint64_t value = 0;
+
+    switch(_M_prefix)
+    {
+    case app::prefix::varint:
+        for(n = 0; ; ++n)
+        {
+            if(n == max_prefix) throw errno_error(std::make_error_code(std::errc::bad_message));
+            if(n == size) return false;
+
+            // 10th byte only holds the top bit
+            if(n == max_prefix - 1 && p[n] > 1) throw errno_error(std::make_error_code(std::errc::bad_message));
+
+            value |= uint64_t(p[n] & 0x7f) << (7 * n);
+            if(value > _M_max_frame) throw errno_error(std::make_error_code(std::errc::message_size));
+
+            if(!(p[n] & 0x80)) break;
+        }
+        ++n;
+        break;
+
+    case app::prefix::fixed16:
+        if(size < 2) return false;
+        value = (p[0] << 8) | p[1];
+        n = 2;
+        break;
+
+    case app::prefix::fixed32:
+        if(size < 4) return false;
+        value = (uint32_t(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+        n = 4;
+        break;
+    }
+
+    if(value > _M_max_frame) throw errno_error(std::make_error_code(std::errc::message_size));
+    length = value;
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void framer::copy(size_t pos, void* buffer, size_t n) const
+{
+    size_t start = (_M_head + pos) % _M_ring.size();
+    size_t first = std::min(n, _M_ring.size() - start);
+
+    memcpy(buffer, _M_ring.data() + start, first);
+    memcpy(static_cast<char*>(buffer) + first, _M_ring.data(), n - first);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool framer::parse(app::const_span& frame)
+{
+    char prefix[max_prefix];
+    size_t size = std::min(_M_size, max_prefix);
+    copy(0, prefix, size);
+
+    size_t n, length;
+    if(!decode(prefix, size, n, length) || _M_size < n + length) return false;
+
+    size_t start = (_M_head + n) % _M_ring.size();
+    if(start + length <= _M_ring.size())
+        frame = app::const_span(_M_ring.data() + start, length);
+    else
+    {
+        // wrapped around
+        _M_scratch.resize(length);
+        copy(n, _M_scratch.data(), length);
+
+        frame = app::const_span(_M_scratch.data(), length);
+    }
+
+    _M_used = n + length;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool framer::fill(bool wait)
+{
+    size_t tail = (_M_head + _M_size) % _M_ring.size();
+    size_t free = _M_ring.size() - _M_size;
+
+    app::span spans[2];
+    spans[0] = app::span(_M_ring.data() + tail, std::min(free, _M_ring.size() - tail));
+    spans[1] = app::span(_M_ring.data(), free - spans[0].size);
+
+    size_t n = spans[1].size ? 2 : 1;
+
+    size_t count = _M_socket.recv(spans, n, wait);
+    if(count == 0 && !wait)
+    {
+        // 0 means either no data or end of stream; only the latter leaves the socket readable
+        if(!_M_socket.can_recv(std::chrono::seconds(0))) return false;
+        count = _M_socket.recv(spans, n, false);
+    }
+
+    if(count == 0)
+    {
+        _M_eof = true;
+        return false;
+    }
+
+    _M_size += count;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool framer::recv(app::const_span& frame, bool wait)
+{
+    // release previous frame
+    if(_M_used)
+    {
+        _M_head = (_M_head + _M_used) % _M_ring.size();
+        _M_size -= _M_used;
+        _M_used = 0;
+
+        if(_M_size == 0) _M_head = 0;
+    }
+
+    for(;;)
+    {
+        if(parse(frame)) return true;
+        if(_M_eof || !fill(wait)) return false;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool framer::recv(app::buffer& buffer, bool wait)
+{
+    app::const_span frame;
+    if(!recv(frame, wait)) return false;
+
+    buffer.assign(frame.data, frame.size);
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool framer::recv(std::string& string, bool wait)
+{
+    app::const_span frame;
+    if(!recv(frame, wait)) return false;
+
+    string.assign(static_cast<const char*>(frame.data), frame.size);
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool framer::send(const app::const_span* spans, size_t n, bool wait)
+{
+    size_t size = 0;
+    for(size_t i = 0; i < n; ++i) size += spans[i].size;
+    if(size > _M_max_frame) throw errno_error(std::make_error_code(std::errc::message_size));
+    // one slot is taken by the prefix
+    if(n >= IOV_MAX) throw errno_error(std::make_error_code(std::errc::invalid_argument));
+
+    char prefix[max_prefix];
+    size_t count = n + 1;
+
+    // spans zero-initialize, so only go to the heap for long lists
+    app::const_span local[16];
+    std::vector<app::const_span> heap;
+
+    app::const_span* iov = local;
+    if(count > sizeof(local) / sizeof(local[0]))
+    {
+        heap.resize(count);
+        iov = heap.data();
+    }
+    iov[0] = app::const_span(prefix, encode(size, prefix));
+    std::copy(spans, spans + n, iov + 1);
+
+    app::const_span* first = iov;
+    if(flush(wait))
+        for(;;)
+        {
+            size_t done = _M_socket.send(first, count, wait);
+            while(count && done >= first->size)
+            {
+                done -= first->size;
+                ++first;
+                --count;
+            }
+            if(count == 0) return true;
+
+            first->data = static_cast<const char*>(first->data) + done;
+            first->size -= done;
+
+            if(!wait) break;
+        }
+
+    for(; count; ++first, --count) _M_out.append(first->data, first->size);
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool framer::flush(bool wait)
+{
+    while(_M_out_pos < _M_out.size())
+    {
+        size_t count = _M_socket.send(_M_out.data() + _M_out_pos, _M_out.size() - _M_out_pos, wait);
+        if(count == 0) return false;
+
+        _M_out_pos += count;
+    }
+
+    _M_out.clear();
+    _M_out_pos = 0;
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+}
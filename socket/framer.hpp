@@ -0,0 +1,148 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2015 Dimitry Ishenko
+// Distributed under the GNU GPL v2. For full terms please visit:
+// http://www.gnu.org/licenses/gpl.html
+//
+// Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef FRAMER_HPP
+#define FRAMER_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#include "buffer.hpp"
+#include "socket/socket.hpp"
+
+#include <cstddef>
+#include <initializer_list>
+#include <string>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace app
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// \brief  frame length prefix
+///
+enum class prefix
+{
+    varint,  //< unsigned LEB128, 1 to 10 bytes
+    fixed16, //< 2 bytes, big endian
+    fixed32, //< 4 bytes, big endian
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// \brief  length-prefixed message framing over a stream socket
+///
+/// Incoming data is read into a ring buffer sized to hold the largest frame, and frames
+/// are returned as spans into it. Only a frame that wraps around the end of the ring is
+/// copied (into a scratch buffer, which is allocated once), so there is no per-message
+/// allocation.
+///
+/// Outgoing frames are written with one gather send (prefix + payload). With wait=false,
+/// whatever the socket does not take is kept in a pending buffer and written out, in
+/// order, by the following send or flush calls.
+///
+/// Works with any app::socket of stream type (eg, net::socket or unix::socket).
+///
+class framer
+{
+public:
+    static constexpr size_t max_prefix = 10;
+
+public:
+    ////////////////////
+    /// \brief  construct framer
+    /// \param  socket stream socket (must outlive the framer)
+    /// \param  max_frame max payload size (larger frames are rejected on both ends)
+    ///
+    framer(app::socket& socket, app::prefix prefix = app::prefix::varint, size_t max_frame = 1 << 20);
+    framer(const framer&) = delete;
+    framer(framer&&) = delete;
+
+    framer& operator=(const framer&) = delete;
+    framer& operator=(framer&&) = delete;
+
+    ////////////////////
+    /// \brief  send frame
+    /// \param  wait block until the frame has been written
+    /// \return false if (part of) the frame has been left pending
+    ///
+    /// Throws errno_error with std::errc::message_size if the frame exceeds max_frame.
+    ///
+    bool send(const void* buffer, size_t n, bool wait = true)
+    {
+        app::const_span span(buffer, n);
+        return send(&span, 1, wait);
+    }
+    bool send(const std::string& string, bool wait = true) { return send(string.data(), string.size(), wait); }
+
+    ////////////////////
+    /// \brief  send frame made up of several pieces
+    ///
+    bool send(std::initializer_list<app::const_span> spans, bool wait = true)
+        { return send(spans.begin(), spans.size(), wait); }
+    bool send(const app::const_span* spans, size_t n, bool wait = true);
+
+    ////////////////////
+    /// \brief  write out pending data
+    /// \return true if there is nothing left pending
+    ///
+    bool flush(bool wait = true);
+
+    size_t pending() const noexcept { return _M_out.size() - _M_out_pos; }
+
+    ////////////////////
+    /// \brief  receive frame
+    /// \param  frame payload; valid until the next recv call
+    /// \param  wait block until a complete frame arrives
+    /// \return false if there is no complete frame yet (wait=false) or end of stream
+    ///
+    /// Throws errno_error with std::errc::message_size if the peer announces a frame
+    /// larger than max_frame, or std::errc::bad_message if the prefix is malformed.
+    ///
+    bool recv(app::const_span& frame, bool wait = true);
+
+    bool recv(app::buffer& buffer, bool wait = true);
+    bool recv(std::string& string, bool wait = true);
+
+    ////////////////////
+    /// \brief  check if the peer has closed the connection
+    ///
+    /// Frames received before the end of stream are still returned by recv.
+    ///
+    bool eof() const noexcept { return _M_eof; }
+
+    ////////////////////
+    /// \brief  number of bytes received but not yet returned as frames
+    ///
+    size_t buffered() const noexcept { return _M_size - _M_used; }
+
+private:
+    app::socket& _M_socket;
+    app::prefix _M_prefix;
+    size_t _M_max_frame;
+
+    app::buffer _M_ring;
+    size_t _M_head = 0, _M_size = 0;
+    size_t _M_used = 0; // bytes taken by the last frame returned from recv
+    bool _M_eof = false;
+
+    app::buffer _M_scratch;
+
+    app::buffer _M_out;
+    size_t _M_out_pos = 0;
+
+    size_t encode(size_t n, char* prefix) const;
+    bool decode(const char* prefix, size_t size, size_t& n, size_t& length) const;
+
+    void copy(size_t pos, void* buffer, size_t n) const;
+    bool parse(app::const_span& frame);
+    bool fill(bool wait);
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#endif // FRAMER_HPP
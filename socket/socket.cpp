@@ -7,19 +7,45 @@
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 #include "errno_error.hpp"
+#include "io_wait.hpp"
 #include "socket.hpp"
+#include "socket_probe.hpp"
 
+#include <algorithm>
+#include <climits>
+#include <cstring>
 #include <ctime>
-#include <memory>
 
 #include <fcntl.h>
-#include <sys/select.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 namespace app
 {
 
+///////////////////////////////////////////////////////////////////////////////////////////////////
+constexpr size_t socket::batch_max;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+const app::socket_metrics& socket::metrics() const
+{
+#if defined(enable_socket_metrics)
+    return *socket_metrics_for(_M_fd);
+#else
+    static const app::socket_metrics empty;
+    return empty;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+using app::internal::clock;
+using app::internal::deadline;
+using app::internal::poll_until;
+using app::internal::advance;
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 socket::socket(int family, socket::type type)
 {
@@ -45,6 +71,10 @@ void socket::close() noexcept
 {
     if(_M_fd != invalid)
     {
+#if defined(enable_socket_metrics)
+        // before the descriptor can be reused
+        release_socket_metrics(_M_fd);
+#endif
         ::close(_M_fd);
         _M_fd = invalid;
     }
@@ -62,6 +92,53 @@ void socket::connect(sockaddr* addr, socklen_t addr_len)
     if(::connect(_M_fd, addr, addr_len)) throw errno_error();
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool socket::begin_connect(sockaddr* addr, socklen_t addr_len)
+{
+    set_non_blocking(true);
+
+    if(::connect(_M_fd, addr, addr_len) == 0) return true;
+    if(errno == EINPROGRESS) return false;
+
+    throw errno_error();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool socket::finish_connect()
+{
+    if(!can_send(std::chrono::seconds(0))) return false;
+
+    int val = 0;
+    socklen_t len = sizeof(val);
+    if(getsockopt(_M_fd, SOL_SOCKET, SO_ERROR, &val, &len)) throw errno_error();
+
+    if(val) throw errno_error(std::error_code(val, std::generic_category()));
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void socket::connect(sockaddr* addr, socklen_t addr_len, std::chrono::seconds s, std::chrono::nanoseconds n)
+{
+    int opt = fcntl(_M_fd, F_GETFL);
+    if(opt < 0) throw errno_error();
+
+    try
+    {
+        if(!begin_connect(addr, addr_len))
+        {
+            if(!can_send(s, n)) throw errno_error(std::make_error_code(std::errc::timed_out));
+            finish_connect();
+        }
+    }
+    catch(...)
+    {
+        fcntl(_M_fd, F_SETFL, opt);
+        throw;
+    }
+
+    if(fcntl(_M_fd, F_SETFL, opt)) throw errno_error();
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 void socket::listen(int max)
 {
@@ -75,6 +152,25 @@ void socket::accept(app::socket& socket)
     if(socket._M_fd == invalid) throw errno_error();
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool socket::accept(app::socket& socket, sockaddr* addr, socklen_t* addr_len, int flags, bool wait)
+{
+    if(!wait && !can_recv(std::chrono::seconds(0))) return false;
+
+    int fd = ::accept4(_M_fd, addr, addr_len, flags);
+    if(fd == invalid)
+    {
+        // someone else may have taken it
+        if(!wait && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return false;
+        else throw errno_error();
+    }
+
+    socket.close();
+    socket._M_fd = fd;
+    return true;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 void socket::set_non_blocking(bool value)
 {
@@ -89,16 +185,101 @@ void socket::set_non_blocking(bool value)
     if(fcntl(_M_fd, F_SETFL, opt)) throw errno_error();
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void socket::set_option(int level, int name, int value)
+{
+    if(setsockopt(_M_fd, level, name, &value, sizeof(value))) throw errno_error();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+int socket::get_option(int level, int name) const
+{
+    int value = 0;
+    socklen_t len = sizeof(value);
+
+    if(getsockopt(_M_fd, level, name, &value, &len)) throw errno_error();
+    return value;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void socket::set_recv_buffer(int size, bool force)
+{
+    set_option(SOL_SOCKET, force ? SO_RCVBUFFORCE : SO_RCVBUF, size);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+int socket::recv_buffer() const
+{
+    return get_option(SOL_SOCKET, SO_RCVBUF);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void socket::set_send_buffer(int size, bool force)
+{
+    set_option(SOL_SOCKET, force ? SO_SNDBUFFORCE : SO_SNDBUF, size);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+int socket::send_buffer() const
+{
+    return get_option(SOL_SOCKET, SO_SNDBUF);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void socket::set_busy_poll(std::chrono::microseconds x)
+{
+    set_option(SOL_SOCKET, SO_BUSY_POLL, static_cast<int>(x.count()));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+std::chrono::microseconds socket::busy_poll() const
+{
+    return std::chrono::microseconds(get_option(SOL_SOCKET, SO_BUSY_POLL));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void socket::set_priority(int x)
+{
+    set_option(SOL_SOCKET, SO_PRIORITY, x);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+int socket::priority() const
+{
+    return get_option(SOL_SOCKET, SO_PRIORITY);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void socket::set_timestamp(bool x)
+{
+    set_option(SOL_SOCKET, SO_TIMESTAMPNS, x ? 1 : 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool socket::timestamp() const
+{
+    return get_option(SOL_SOCKET, SO_TIMESTAMPNS);
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 bool socket::can_recv(std::chrono::seconds s, std::chrono::nanoseconds n)
 {
     timespec time = { static_cast<std::time_t>(s.count()), static_cast<long>(n.count()) };
+    pollfd fd = { _M_fd, POLLIN, 0 };
+
+    int count = ppoll(&fd, 1, &time, nullptr);
+    if(count == -1) throw errno_error();
+
+    return count;
+}
 
-    fd_set fds;
-    FD_ZERO(&fds);
-    FD_SET(_M_fd, &fds);
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool socket::can_send(std::chrono::seconds s, std::chrono::nanoseconds n)
+{
+    timespec time = { static_cast<std::time_t>(s.count()), static_cast<long>(n.count()) };
+    pollfd fd = { _M_fd, POLLOUT, 0 };
 
-    int count = pselect(_M_fd+1, &fds, nullptr, nullptr, &time, nullptr);
+    int count = ppoll(&fd, 1, &time, nullptr);
     if(count == -1) throw errno_error();
 
     return count;
@@ -107,66 +288,316 @@ bool socket::can_recv(std::chrono::seconds s, std::chrono::nanoseconds n)
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 size_t socket::send(const void* buffer, size_t n, bool wait)
 {
+    socket_probe probe(*this, true, wait);
     ssize_t count = ::send(_M_fd, buffer, n, (wait ? 0 : MSG_DONTWAIT) | MSG_NOSIGNAL);
     if(count == -1)
     {
+        probe.fail(errno);
         if(!wait && (errno == EAGAIN || errno == EWOULDBLOCK))
             return 0;
         else throw errno_error();
     }
+    probe.done(count, n);
     return count;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 size_t socket::send_to(sockaddr* addr, socklen_t addr_len, const void* buffer, size_t n, bool wait)
 {
+    socket_probe probe(*this, true, wait);
     ssize_t count = ::sendto(_M_fd, buffer, n, (wait ? 0 : MSG_DONTWAIT) | MSG_NOSIGNAL, addr, addr_len);
     if(count == -1)
     {
+        probe.fail(errno);
         if(!wait && (errno == EAGAIN || errno == EWOULDBLOCK))
             return 0;
         else throw errno_error();
     }
+    probe.done(count, n);
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t socket::send(const app::const_span* spans, size_t n, bool wait)
+{
+    return send_to(nullptr, 0, spans, n, wait);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t socket::send_to(sockaddr* addr, socklen_t addr_len, const app::const_span* spans, size_t n, bool wait)
+{
+    if(n == 0) return 0;
+    if(n > IOV_MAX) throw errno_error(std::make_error_code(std::errc::invalid_argument));
+
+    iovec iov[IOV_MAX];
+    size_t requested = 0;
+    for(size_t i = 0; i < n; ++i)
+    {
+        iov[i].iov_base = const_cast<void*>(spans[i].data);
+        iov[i].iov_len = spans[i].size;
+        requested += spans[i].size;
+    }
+
+    msghdr msg = { };
+    msg.msg_name = addr;
+    msg.msg_namelen = addr_len;
+    msg.msg_iov = iov;
+    msg.msg_iovlen = n;
+
+    socket_probe probe(*this, true, wait);
+    ssize_t count = ::sendmsg(_M_fd, &msg, (wait ? 0 : MSG_DONTWAIT) | MSG_NOSIGNAL);
+    if(count == -1)
+    {
+        probe.fail(errno);
+        if(!wait && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 0;
+        else throw errno_error();
+    }
+    probe.done(count, requested);
     return count;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 size_t socket::recv(std::string& string, size_t max, bool wait)
 {
-    std::unique_ptr<char[]> buffer(new char[max + 1]);
+    string.resize(max);
 
-    ssize_t count = recv(buffer.get(), max, wait);
-    buffer[count] = '\0';
+    size_t count = recv(&string[0], max, wait);
+    string.resize(count);
+
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t socket::recv(app::buffer& buffer, size_t max, bool wait)
+{
+    buffer.resize(max);
+
+    size_t count = recv(buffer.data(), max, wait);
+    buffer.resize(count);
 
-    string.assign(buffer.get(), count);
     return count;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 size_t socket::recv(void* buffer, size_t max, bool wait)
 {
+    socket_probe probe(*this, false, wait);
     ssize_t count = ::recv(_M_fd, buffer, max, wait ? 0 : MSG_DONTWAIT);
     if(count == -1)
     {
+        probe.fail(errno);
         if(!wait && (errno == EAGAIN || errno == EWOULDBLOCK))
             return 0;
         else throw errno_error();
     }
+    probe.done(count);
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t socket::recv(const app::span* spans, size_t n, bool wait)
+{
+    if(n == 0) return 0;
+    if(n > IOV_MAX) throw errno_error(std::make_error_code(std::errc::invalid_argument));
+
+    iovec iov[IOV_MAX];
+    for(size_t i = 0; i < n; ++i)
+    {
+        iov[i].iov_base = spans[i].data;
+        iov[i].iov_len = spans[i].size;
+    }
+
+    msghdr msg = { };
+    msg.msg_iov = iov;
+    msg.msg_iovlen = n;
+
+    socket_probe probe(*this, false, wait);
+    ssize_t count = ::recvmsg(_M_fd, &msg, wait ? 0 : MSG_DONTWAIT);
+    if(count == -1)
+    {
+        probe.fail(errno);
+        if(!wait && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 0;
+        else throw errno_error();
+    }
+    probe.done(count);
     return count;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 size_t socket::recv_from(sockaddr* addr, socklen_t& addr_len, void* buffer, size_t n, bool wait)
 {
+    socket_probe probe(*this, false, wait);
     ssize_t count = ::recvfrom(_M_fd, buffer, n, wait ? 0 : MSG_DONTWAIT, addr, &addr_len);
     if(count == -1)
     {
+        probe.fail(errno);
+        if(!wait && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 0;
+        else throw errno_error();
+    }
+    probe.done(count);
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t socket::recv_from(sockaddr* addr, socklen_t& addr_len, void* buffer, size_t n, time_point& time, bool wait)
+{
+    iovec iov = { buffer, n };
+    char control[CMSG_SPACE(sizeof(timespec))];
+
+    msghdr msg = { };
+    msg.msg_name = addr;
+    msg.msg_namelen = addr_len;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    socket_probe probe(*this, false, wait);
+    ssize_t count = ::recvmsg(_M_fd, &msg, wait ? 0 : MSG_DONTWAIT);
+    if(count == -1)
+    {
+        probe.fail(errno);
         if(!wait && (errno == EAGAIN || errno == EWOULDBLOCK))
             return 0;
         else throw errno_error();
     }
+    probe.done(count);
+    addr_len = msg.msg_namelen;
+
+    time = time_point();
+    for(cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+        {
+            timespec ts;
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+
+            time += std::chrono::duration_cast<time_point::duration>(
+                std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec)
+            );
+        }
+
     return count;
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t socket::send_many(mmsghdr* msgs, size_t n, bool wait)
+{
+    socket_probe probe(*this, true, wait);
+    int count = ::sendmmsg(_M_fd, msgs, n, (wait ? 0 : MSG_DONTWAIT) | MSG_NOSIGNAL);
+    if(count == -1)
+    {
+        probe.fail(errno);
+        if(!wait && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 0;
+        else throw errno_error();
+    }
+    probe.done(msgs, count);
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t socket::recv_many(mmsghdr* msgs, size_t n, bool wait)
+{
+    // when waiting, block for the first message only and take whatever else is queued
+    socket_probe probe(*this, false, wait);
+    int count = ::recvmmsg(_M_fd, msgs, n, wait ? MSG_WAITFORONE : MSG_DONTWAIT, nullptr);
+    if(count == -1)
+    {
+        probe.fail(errno);
+        if(!wait && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 0;
+        else throw errno_error();
+    }
+    probe.done(msgs, count);
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void socket::send_all(const app::const_span* spans, size_t n, std::chrono::seconds s, std::chrono::nanoseconds ns)
+{
+    if(n == 0) return;
+    if(n > IOV_MAX) throw errno_error(std::make_error_code(std::errc::invalid_argument));
+
+    clock::time_point time = deadline(s, ns);
+
+    iovec iov[IOV_MAX];
+    for(size_t i = 0; i < n; ++i)
+    {
+        iov[i].iov_base = const_cast<void*>(spans[i].data);
+        iov[i].iov_len = spans[i].size;
+    }
+
+    iovec* next = iov;
+    for(advance(next, n, 0); n; )
+    {
+        msghdr msg = { };
+        msg.msg_iov = next;
+        msg.msg_iovlen = n;
+
+        socket_probe probe(*this, true, false);
+        ssize_t count = ::sendmsg(_M_fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if(count == -1)
+        {
+            probe.fail(errno);
+            if(errno == EINTR) continue;
+            if(errno != EAGAIN && errno != EWOULDBLOCK) throw errno_error();
+
+            if(!poll_until(_M_fd, POLLOUT, time)) throw errno_error(std::make_error_code(std::errc::timed_out));
+            continue;
+        }
+        probe.done(count);
+
+        advance(next, n, count);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t socket::recv_exact(const app::span* spans, size_t n, std::chrono::seconds s, std::chrono::nanoseconds ns)
+{
+    if(n == 0) return 0;
+    if(n > IOV_MAX) throw errno_error(std::make_error_code(std::errc::invalid_argument));
+
+    clock::time_point time = deadline(s, ns);
+
+    iovec iov[IOV_MAX];
+    for(size_t i = 0; i < n; ++i)
+    {
+        iov[i].iov_base = spans[i].data;
+        iov[i].iov_len = spans[i].size;
+    }
+
+    size_t total = 0;
+
+    iovec* next = iov;
+    for(advance(next, n, 0); n; )
+    {
+        msghdr msg = { };
+        msg.msg_iov = next;
+        msg.msg_iovlen = n;
+
+        socket_probe probe(*this, false, false);
+        ssize_t count = ::recvmsg(_M_fd, &msg, MSG_DONTWAIT);
+        if(count == -1)
+        {
+            probe.fail(errno);
+            if(errno == EINTR) continue;
+            if(errno != EAGAIN && errno != EWOULDBLOCK) throw errno_error();
+
+            if(!poll_until(_M_fd, POLLIN, time)) throw errno_error(std::make_error_code(std::errc::timed_out));
+            continue;
+        }
+        probe.done(count);
+
+        if(count == 0) break; // peer closed connection
+
+        total += count;
+        advance(next, n, count);
+    }
+    return total;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 }
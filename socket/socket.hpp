@@ -10,19 +10,36 @@
 #define SOCKET_HPP
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
+#include "buffer.hpp"
+#include "socket_metrics.hpp"
+
 #include <chrono>
+#include <initializer_list>
 #include <string>
 
 #include <sys/socket.h>
 #include <sys/types.h>
 
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// Socket metrics are opt-in: define enable_socket_metrics (eg, add -Denable_socket_metrics to
+/// DEFINES). Each socket then counts its calls, bytes, EAGAINs and errors, and keeps latency
+/// histograms of blocking calls (see socket_metrics.hpp). Without it, the instrumentation
+/// compiles away and metrics() returns an empty instance. Metrics are kept outside of
+/// the socket, so its layout is the same either way.
+///
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 struct sockaddr;
+struct mmsghdr;
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 namespace app
 {
 
+///////////////////////////////////////////////////////////////////////////////////////////////////
+class ring;
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 class socket
 {
@@ -32,6 +49,8 @@ public:
 
     enum type { stream, datagram };
 
+    typedef std::chrono::system_clock::time_point time_point;
+
 public:
     socket() noexcept = default;
     socket(const socket&) = delete;
@@ -58,6 +77,43 @@ public:
 
     void set_non_blocking(bool);
 
+    ////////////////////
+    /// \brief set receive buffer size (SO_RCVBUF)
+    /// \param force exceed rmem_max limit (SO_RCVBUFFORCE, needs CAP_NET_ADMIN)
+    ///
+    /// NB: the kernel doubles the value to allow for bookkeeping overhead,
+    /// and recv_buffer returns the doubled value.
+    ///
+    void set_recv_buffer(int size, bool force = false);
+    int recv_buffer() const;
+
+    ////////////////////
+    /// \brief set send buffer size (SO_SNDBUF)
+    /// \param force exceed wmem_max limit (SO_SNDBUFFORCE, needs CAP_NET_ADMIN)
+    ///
+    void set_send_buffer(int size, bool force = false);
+    int send_buffer() const;
+
+    ////////////////////
+    /// \brief busy poll device queue on blocking receive (SO_BUSY_POLL)
+    ///
+    void set_busy_poll(std::chrono::microseconds);
+    std::chrono::microseconds busy_poll() const;
+
+    ////////////////////
+    /// \brief set protocol-defined priority of outgoing packets (SO_PRIORITY)
+    ///
+    void set_priority(int);
+    int priority() const;
+
+    ////////////////////
+    /// \brief enable kernel receive timestamps (SO_TIMESTAMPNS)
+    ///
+    /// Timestamps are returned by the recv_from overloads taking time_point.
+    ///
+    void set_timestamp(bool);
+    bool timestamp() const;
+
     template<typename Rep, typename Period>
     bool can_recv(const std::chrono::duration<Rep, Period>& x)
     {
@@ -66,27 +122,146 @@ public:
         return can_recv(s, n);
     }
 
+    template<typename Rep, typename Period>
+    bool can_send(const std::chrono::duration<Rep, Period>& x)
+    {
+        std::chrono::seconds s = std::chrono::duration_cast<std::chrono::seconds>(x);
+        std::chrono::nanoseconds n = std::chrono::duration_cast<std::chrono::nanoseconds>(x - s);
+        return can_send(s, n);
+    }
+
+    ////////////////////
+    /// \brief complete connection started with begin_connect
+    /// \return true if connected, false if still in progress
+    ///
+    /// Throws if the connection has failed. Call it when the socket becomes writable.
+    ///
+    bool finish_connect();
+
     size_t send(const std::string& string, bool wait = true)
         { return send(string.data(), string.size(), wait); }
     size_t send(const void* buffer, size_t n, bool wait = true);
 
+    ////////////////////
+    /// \brief gather send (sendmsg): send several buffers in one syscall
+    ///
+    size_t send(std::initializer_list<app::const_span> spans, bool wait = true)
+        { return send(spans.begin(), spans.size(), wait); }
+    size_t send(const app::const_span* spans, size_t n, bool wait = true);
+
     size_t recv(std::string& string, size_t max, bool wait = true);
+    size_t recv(app::buffer& buffer, size_t max, bool wait = true);
     size_t recv(void* buffer, size_t max, bool wait = true);
 
+    ////////////////////
+    /// \brief scatter receive (recvmsg): fill several buffers in one syscall
+    ///
+    size_t recv(std::initializer_list<app::span> spans, bool wait = true)
+        { return recv(spans.begin(), spans.size(), wait); }
+    size_t recv(const app::span* spans, size_t n, bool wait = true);
+
+    ////////////////////
+    /// \brief send all data, retrying partial sends
+    /// \param x overall time limit (negative = no limit)
+    ///
+    /// Retries on EINTR and waits for the socket to become writable on EAGAIN.
+    /// Several buffers are sent with sendmsg. Throws errc::timed_out if the time
+    /// limit expires; some of the data may have been sent by then.
+    ///
+    template<typename Rep, typename Period>
+    void send_all(const app::const_span* spans, size_t n, const std::chrono::duration<Rep, Period>& x)
+    {
+        std::chrono::seconds s = std::chrono::duration_cast<std::chrono::seconds>(x);
+        std::chrono::nanoseconds ns = std::chrono::duration_cast<std::chrono::nanoseconds>(x - s);
+        send_all(spans, n, s, ns);
+    }
+
+    template<typename Rep, typename Period>
+    void send_all(std::initializer_list<app::const_span> spans, const std::chrono::duration<Rep, Period>& x)
+        { send_all(spans.begin(), spans.size(), x); }
+    template<typename Rep, typename Period>
+    void send_all(const void* buffer, size_t n, const std::chrono::duration<Rep, Period>& x)
+        { app::const_span span(buffer, n); send_all(&span, 1, x); }
+    template<typename Rep, typename Period>
+    void send_all(const std::string& string, const std::chrono::duration<Rep, Period>& x)
+        { send_all(string.data(), string.size(), x); }
+
+    void send_all(const app::const_span* spans, size_t n) { send_all(spans, n, std::chrono::seconds(-1)); }
+    void send_all(std::initializer_list<app::const_span> spans) { send_all(spans, std::chrono::seconds(-1)); }
+    void send_all(const void* buffer, size_t n) { send_all(buffer, n, std::chrono::seconds(-1)); }
+    void send_all(const std::string& string) { send_all(string, std::chrono::seconds(-1)); }
+
+    ////////////////////
+    /// \brief receive exactly n bytes (stream sockets)
+    /// \param x overall time limit (negative = no limit)
+    /// \return n, or less if the peer has closed the connection
+    ///
+    /// Retries on EINTR and waits for the socket to become readable on EAGAIN.
+    /// Several buffers are filled with recvmsg. Throws errc::timed_out if the time
+    /// limit expires; some of the data may have been received by then.
+    ///
+    template<typename Rep, typename Period>
+    size_t recv_exact(const app::span* spans, size_t n, const std::chrono::duration<Rep, Period>& x)
+    {
+        std::chrono::seconds s = std::chrono::duration_cast<std::chrono::seconds>(x);
+        std::chrono::nanoseconds ns = std::chrono::duration_cast<std::chrono::nanoseconds>(x - s);
+        return recv_exact(spans, n, s, ns);
+    }
+
+    template<typename Rep, typename Period>
+    size_t recv_exact(std::initializer_list<app::span> spans, const std::chrono::duration<Rep, Period>& x)
+        { return recv_exact(spans.begin(), spans.size(), x); }
+    template<typename Rep, typename Period>
+    size_t recv_exact(void* buffer, size_t n, const std::chrono::duration<Rep, Period>& x)
+        { app::span span(buffer, n); return recv_exact(&span, 1, x); }
+
+    size_t recv_exact(const app::span* spans, size_t n) { return recv_exact(spans, n, std::chrono::seconds(-1)); }
+    size_t recv_exact(std::initializer_list<app::span> spans) { return recv_exact(spans, std::chrono::seconds(-1)); }
+    size_t recv_exact(void* buffer, size_t n) { return recv_exact(buffer, n, std::chrono::seconds(-1)); }
+
     socket::id get_id() const noexcept { return _M_fd; }
 
+    ////////////////////
+    /// \brief get metrics of this socket
+    ///
+    /// Metrics are created on first use and retired (added to the totals
+    /// reported by dump_socket_metrics) when the socket is closed.
+    ///
+    const app::socket_metrics& metrics() const;
+
 protected:
     socket::id _M_fd = invalid;
 
     socket(int family, socket::type);
 
     bool can_recv(std::chrono::seconds, std::chrono::nanoseconds);
+    bool can_send(std::chrono::seconds, std::chrono::nanoseconds);
 
     void bind(sockaddr* addr, socklen_t addr_len);
     void connect(sockaddr* addr, socklen_t addr_len);
+    void connect(sockaddr* addr, socklen_t addr_len, std::chrono::seconds, std::chrono::nanoseconds);
+    bool begin_connect(sockaddr* addr, socklen_t addr_len);
+
+    void send_all(const app::const_span* spans, size_t n, std::chrono::seconds, std::chrono::nanoseconds);
+    size_t recv_exact(const app::span* spans, size_t n, std::chrono::seconds, std::chrono::nanoseconds);
+
+    bool accept(app::socket& socket, sockaddr* addr, socklen_t* addr_len, int flags, bool wait);
+
+    void set_option(int level, int name, int value);
+    int get_option(int level, int name) const;
 
     size_t send_to(sockaddr* addr, socklen_t addr_len, const void* buffer, size_t n, bool wait = true);
+    size_t send_to(sockaddr* addr, socklen_t addr_len, const app::const_span* spans, size_t n, bool wait = true);
     size_t recv_from(sockaddr* addr, socklen_t& addr_len, void* buffer, size_t n, bool wait = true);
+    size_t recv_from(sockaddr* addr, socklen_t& addr_len, void* buffer, size_t n, time_point& time, bool wait = true);
+
+    size_t send_many(mmsghdr* msgs, size_t n, bool wait = true);
+    size_t recv_many(mmsghdr* msgs, size_t n, bool wait = true);
+
+    // max number of messages passed to the kernel at once
+    static constexpr size_t batch_max = 64;
+
+    friend class app::ring;
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,249 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2015 Dimitry Ishenko
+// Distributed under the GNU GPL v2. For full terms please visit:
+// http://www.gnu.org/licenses/gpl.html
+//
+// Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#include "socket_metrics.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <unordered_set>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace app
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+constexpr size_t histogram::size;
+constexpr int socket_metrics::errno_max;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t histogram::index(uint64_t value) noexcept
+{
+    if(value < 4) return value;
+
+    size_t msb = 63 - __builtin_clzll(value);
+    return (msb - 1) * 4 + ((value >> (msb - 2)) & 3);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+uint64_t histogram::lower(size_t index) noexcept
+{
+    if(index < 4) return index;
+
+    size_t msb = index / 4 + 1;
+    return uint64_t(4 + index % 4) << (msb - 2);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void histogram::add(const histogram& x) noexcept
+{
+    for(size_t n = 0; n < size; ++n)
+        _M_count[n].fetch_add(x._M_count[n].load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void histogram::clear() noexcept
+{
+    for(auto& x : _M_count) x.store(0, std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+uint64_t histogram::count() const noexcept
+{
+    uint64_t total = 0;
+    for(const auto& x : _M_count) total += x.load(std::memory_order_relaxed);
+    return total;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+uint64_t histogram::percentile(double p) const noexcept
+{
+    uint64_t total = count();
+    if(total == 0) return 0;
+
+    uint64_t rank = std::max<uint64_t>(1, std::ceil(total * std::min(p, 100.0) / 100));
+    uint64_t seen = 0;
+
+    for(size_t n = 0; n < size; ++n)
+    {
+        seen += _M_count[n].load(std::memory_order_relaxed);
+        if(seen >= rank) return upper(n);
+    }
+    return UINT64_MAX;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+socket_metrics::socket_metrics(int id) noexcept: id(id)
+{
+    for(auto x : { &send_calls, &send_bytes, &recv_calls, &recv_bytes, &again, &partial_sends })
+        x->store(0, std::memory_order_relaxed);
+    for(auto& x : errors) x.store(0, std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void socket_metrics::add(const socket_metrics& x) noexcept
+{
+    auto add = [](std::atomic<uint64_t>& to, const std::atomic<uint64_t>& from)
+    {
+        to.fetch_add(from.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    };
+
+    add(send_calls, x.send_calls);
+    add(send_bytes, x.send_bytes);
+    add(recv_calls, x.recv_calls);
+    add(recv_bytes, x.recv_bytes);
+    add(again, x.again);
+    add(partial_sends, x.partial_sends);
+
+    for(int n = 0; n <= errno_max; ++n) add(errors[n], x.errors[n]);
+
+    send_latency.add(x.send_latency);
+    recv_latency.add(x.recv_latency);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void socket_metrics::dump(std::ostream& stream) const
+{
+    auto load = [](const std::atomic<uint64_t>& x) { return x.load(std::memory_order_relaxed); };
+
+    stream << "send: " << load(send_calls) << " calls, " << load(send_bytes) << " bytes, "
+           << load(partial_sends) << " partial\n"
+           << "recv: " << load(recv_calls) << " calls, " << load(recv_bytes) << " bytes\n"
+           << "again: " << load(again) << "\n";
+
+    for(int n = 0; n <= errno_max; ++n)
+        if(uint64_t count = load(errors[n]))
+        {
+            stream << "error: ";
+            if(n < errno_max)
+                stream << std::generic_category().message(n);
+            else stream << "other";
+            stream << ": " << count << "\n";
+        }
+
+    for(auto x : { std::make_pair("send", &send_latency), std::make_pair("recv", &recv_latency) })
+        if(x.second->count())
+            stream << x.first << " latency (ns): p50 " << x.second->percentile(50)
+                   << ", p90 " << x.second->percentile(90)
+                   << ", p99 " << x.second->percentile(99)
+                   << ", max " << x.second->percentile(100) << "\n";
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace
+{
+
+struct registry
+{
+    std::mutex mutex;
+    std::unordered_set<app::socket_metrics*> live;
+    app::socket_metrics retired;
+};
+
+registry& instance()
+{
+    static registry* x = new registry(); // never destroyed, sockets may outlive statics
+    return *x;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// descriptor -> metrics table, in blocks allocated on first use and never freed
+typedef std::atomic<app::socket_metrics*> slot;
+
+constexpr size_t block_size = 1024;
+constexpr size_t block_count = 4096;
+
+std::atomic<slot*> blocks[block_count];
+
+slot* slot_for(int id)
+{
+    if(id < 0 || static_cast<size_t>(id) >= block_size * block_count) return nullptr;
+
+    std::atomic<slot*>& entry = blocks[id / block_size];
+
+    slot* block = entry.load(std::memory_order_acquire);
+    if(!block)
+    {
+        slot* fresh = new slot[block_size];
+        for(size_t n = 0; n < block_size; ++n) fresh[n].store(nullptr, std::memory_order_relaxed);
+
+        if(entry.compare_exchange_strong(block, fresh, std::memory_order_acq_rel, std::memory_order_acquire))
+            block = fresh;
+        else delete[] fresh;
+    }
+    return block + id % block_size;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void retire(app::socket_metrics* metrics) noexcept
+{
+    registry& r = instance();
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.live.erase(metrics);
+        r.retired.add(*metrics);
+    }
+    delete metrics;
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+app::socket_metrics* socket_metrics_for(int id)
+{
+    slot* x = slot_for(id);
+    // out of range descriptors are counted straight into the totals
+    if(!x) return &instance().retired;
+
+    // send and recv may be called from different threads
+    app::socket_metrics* metrics = x->load(std::memory_order_acquire);
+    if(!metrics)
+    {
+        std::unique_ptr<app::socket_metrics> fresh(new app::socket_metrics(id));
+        {
+            registry& r = instance();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            r.live.insert(fresh.get());
+        }
+
+        if(x->compare_exchange_strong(metrics, fresh.get(), std::memory_order_acq_rel, std::memory_order_acquire))
+            metrics = fresh.release();
+        else retire(fresh.release());
+    }
+    return metrics;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void release_socket_metrics(int id) noexcept
+{
+    if(slot* x = slot_for(id))
+        if(app::socket_metrics* metrics = x->exchange(nullptr, std::memory_order_acquire)) retire(metrics);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void dump_socket_metrics(std::ostream& stream)
+{
+    registry& r = instance();
+    {
+        // keeps live metrics from being retired while dumping
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for(auto x : r.live)
+        {
+            stream << "socket " << x->id << ":\n";
+            x->dump(stream);
+        }
+    }
+
+    stream << "closed sockets:\n";
+    r.retired.dump(stream);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+}
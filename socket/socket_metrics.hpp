@@ -0,0 +1,109 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2015 Dimitry Ishenko
+// Distributed under the GNU GPL v2. For full terms please visit:
+// http://www.gnu.org/licenses/gpl.html
+//
+// Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef SOCKET_METRICS_HPP
+#define SOCKET_METRICS_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace app
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// \brief  log-linear histogram (HDR-style)
+///
+/// Each power of 2 is split into 4 linear sub-buckets, so values are kept within
+/// 25% precision over the whole uint64_t range. Recording is a relaxed increment.
+///
+class histogram
+{
+public:
+    static constexpr size_t size = 256;
+
+public:
+    histogram() noexcept { clear(); }
+    histogram(const histogram&) = delete;
+    histogram& operator=(const histogram&) = delete;
+
+    void record(uint64_t value) noexcept { _M_count[index(value)].fetch_add(1, std::memory_order_relaxed); }
+
+    void add(const histogram&) noexcept;
+    void clear() noexcept;
+
+    uint64_t count() const noexcept;
+
+    ////////////////////
+    /// \brief  value below which p percent (0-100) of recorded values fall
+    /// \return upper bound of the bucket holding the percentile
+    ///
+    uint64_t percentile(double p) const noexcept;
+
+    static size_t index(uint64_t value) noexcept;
+    static uint64_t lower(size_t index) noexcept;
+    static uint64_t upper(size_t index) noexcept { return index + 1 < size ? lower(index + 1) - 1 : UINT64_MAX; }
+
+private:
+    std::atomic<uint64_t> _M_count[size];
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// \brief  socket I/O metrics
+///
+/// Counters are relaxed atomics; latencies (of blocking calls only) are in nanoseconds.
+///
+struct socket_metrics
+{
+    static constexpr int errno_max = 134; // errors >= errno_max are counted in errors[errno_max]
+
+    explicit socket_metrics(int id = -1) noexcept;
+    socket_metrics(const socket_metrics&) = delete;
+    socket_metrics& operator=(const socket_metrics&) = delete;
+
+    int id; //< socket descriptor when the metrics were created
+
+    std::atomic<uint64_t> send_calls, send_bytes;
+    std::atomic<uint64_t> recv_calls, recv_bytes;
+
+    std::atomic<uint64_t> again;         //< calls that returned EAGAIN (wait=false)
+    std::atomic<uint64_t> partial_sends; //< sends that took less than was offered
+    std::atomic<uint64_t> errors[errno_max + 1];
+
+    app::histogram send_latency, recv_latency;
+
+    void add(const socket_metrics&) noexcept;
+    void dump(std::ostream&) const;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// \brief  get metrics of socket descriptor id, creating them on first use
+///
+/// Metrics live in a table indexed by descriptor (so sockets carry no extra state)
+/// and are registered for dump_socket_metrics until released.
+///
+app::socket_metrics* socket_metrics_for(int id);
+
+////////////////////
+/// \brief  detach metrics from socket descriptor id and add their counts to the retired totals
+///
+void release_socket_metrics(int id) noexcept;
+
+////////////////////
+/// \brief  dump metrics of all live sockets, followed by totals of closed ones
+///
+void dump_socket_metrics(std::ostream&);
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#endif // SOCKET_METRICS_HPP
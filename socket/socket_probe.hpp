@@ -0,0 +1,96 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2015 Dimitry Ishenko
+// Distributed under the GNU GPL v2. For full terms please visit:
+// http://www.gnu.org/licenses/gpl.html
+//
+// Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef SOCKET_PROBE_HPP
+#define SOCKET_PROBE_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#include "socket.hpp"
+#include "socket_metrics.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include <sys/socket.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace app
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// records a single send/recv call in socket metrics, if they are enabled
+#if defined(enable_socket_metrics)
+class socket_probe
+{
+public:
+    socket_probe(app::socket& socket, bool send, bool wait):
+        _M_metrics(socket_metrics_for(socket.get_id())), _M_send(send), _M_wait(wait)
+    {
+        if(_M_wait) _M_start = clock::now();
+    }
+
+    void done(size_t count, size_t requested = 0) noexcept
+    {
+        auto& calls = _M_send ? _M_metrics->send_calls : _M_metrics->recv_calls;
+        auto& bytes = _M_send ? _M_metrics->send_bytes : _M_metrics->recv_bytes;
+
+        calls.fetch_add(1, std::memory_order_relaxed);
+        bytes.fetch_add(count, std::memory_order_relaxed);
+
+        if(_M_send && count < requested) _M_metrics->partial_sends.fetch_add(1, std::memory_order_relaxed);
+
+        if(_M_wait)
+        {
+            uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - _M_start).count();
+            (_M_send ? _M_metrics->send_latency : _M_metrics->recv_latency).record(ns);
+        }
+    }
+
+    void done(const mmsghdr* msgs, int count) noexcept
+    {
+        size_t bytes = 0;
+        for(int n = 0; n < count; ++n) bytes += msgs[n].msg_len;
+        done(bytes);
+    }
+
+    void fail(int e) noexcept
+    {
+        if(e == EAGAIN || e == EWOULDBLOCK)
+            _M_metrics->again.fetch_add(1, std::memory_order_relaxed);
+        else _M_metrics->errors[e >= 0 && e < socket_metrics::errno_max ? e : socket_metrics::errno_max]
+            .fetch_add(1, std::memory_order_relaxed);
+    }
+
+private:
+    typedef std::chrono::steady_clock clock;
+
+    app::socket_metrics* _M_metrics;
+    bool _M_send, _M_wait;
+    clock::time_point _M_start;
+};
+
+#else
+class socket_probe
+{
+public:
+    socket_probe(app::socket&, bool, bool) noexcept { }
+
+    void done(size_t, size_t = 0) noexcept { }
+    void done(const mmsghdr*, int) noexcept { }
+    void fail(int) noexcept { }
+};
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#endif // SOCKET_PROBE_HPP
@@ -0,0 +1,194 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2015 Dimitry Ishenko
+// Distributed under the GNU GPL v2. For full terms please visit:
+// http://www.gnu.org/licenses/gpl.html
+//
+// Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#include "errno_error.hpp"
+#include "transfer.hpp"
+
+#include <algorithm>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace app
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// max bytes per sendfile/splice call
+static constexpr size_t chunk = 1 << 30;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+static void wait_for(int fd, short events)
+{
+    pollfd x = { fd, events, 0 };
+    while(::poll(&x, 1, -1) == -1)
+        if(errno != EINTR) throw errno_error();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+static bool would_block() noexcept
+{
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+transfer::transfer(storage::file& from, app::socket& to, storage::offset offset, size_t length):
+    _M_from(from.get_id()), _M_to(to.get_id()), _M_offset(offset), _M_length(length)
+{
+    blocked(_M_to, POLLOUT);
+
+    struct stat x;
+    if(fstat(_M_from, &x)) throw errno_error();
+
+    if(S_ISREG(x.st_mode) || S_ISBLK(x.st_mode))
+        _M_mode = by_sendfile;
+    else if(S_ISFIFO(x.st_mode))
+        _M_mode = by_splice;
+    else
+    {
+        _M_mode = by_pipe;
+        if(pipe2(_M_pipe, O_NONBLOCK | O_CLOEXEC)) throw errno_error();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void transfer::close() noexcept
+{
+    for(int& fd : _M_pipe)
+        if(fd != -1)
+        {
+            ::close(fd);
+            fd = -1;
+        }
+    _M_pending = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t transfer::run(bool wait)
+{
+    switch(_M_mode)
+    {
+    case by_sendfile: return run_sendfile(wait);
+    case by_splice: return run_splice(wait);
+    default: return run_pipe(wait);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t transfer::run_sendfile(bool wait)
+{
+    size_t moved = 0;
+    while(!done())
+    {
+        ssize_t count = ::sendfile(_M_to, _M_from, &_M_offset, std::min(_M_length - _M_count, chunk));
+        if(count == -1)
+        {
+            if(errno == EINTR) continue;
+            if(!would_block()) throw errno_error();
+
+            blocked(_M_to, POLLOUT);
+            if(!wait) break;
+            wait_for(_M_to, POLLOUT);
+        }
+        else if(count == 0)
+            _M_eof = true;
+        else
+        {
+            _M_count += count;
+            moved += count;
+        }
+    }
+    return moved;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t transfer::run_splice(bool wait)
+{
+    size_t moved = 0;
+    while(!done())
+    {
+        ssize_t count = ::splice(_M_from, nullptr, _M_to, nullptr, std::min(_M_length - _M_count, chunk),
+                                 SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if(count == -1)
+        {
+            if(errno == EINTR) continue;
+            if(!would_block()) throw errno_error();
+
+            // either side could have blocked, find out which
+            pollfd x = { _M_from, POLLIN, 0 };
+            if(::poll(&x, 1, 0) > 0)
+                blocked(_M_to, POLLOUT);
+            else blocked(_M_from, POLLIN);
+
+            if(!wait) break;
+            wait_for(_M_wait_fd, _M_wait_events);
+        }
+        else if(count == 0)
+            _M_eof = true;
+        else
+        {
+            _M_count += count;
+            moved += count;
+        }
+    }
+    return moved;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t transfer::run_pipe(bool wait)
+{
+    size_t moved = 0;
+    while(!done())
+    {
+        if(_M_pending == 0)
+        {
+            ssize_t count = ::splice(_M_from, nullptr, _M_pipe[1], nullptr, std::min(_M_length - _M_count, chunk),
+                                     SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if(count == -1)
+            {
+                if(errno == EINTR) continue;
+                if(!would_block()) throw errno_error();
+
+                blocked(_M_from, POLLIN);
+                if(!wait) break;
+                wait_for(_M_from, POLLIN);
+                continue;
+            }
+            else if(count == 0)
+            {
+                _M_eof = true;
+                break;
+            }
+            _M_pending = count;
+        }
+
+        ssize_t count = ::splice(_M_pipe[0], nullptr, _M_to, nullptr, _M_pending, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if(count == -1)
+        {
+            if(errno == EINTR) continue;
+            if(!would_block()) throw errno_error();
+
+            blocked(_M_to, POLLOUT);
+            if(!wait) break;
+            wait_for(_M_to, POLLOUT);
+        }
+        else
+        {
+            _M_pending -= count;
+            _M_count += count;
+            moved += count;
+        }
+    }
+    return moved;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+}
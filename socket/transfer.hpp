@@ -0,0 +1,137 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2015 Dimitry Ishenko
+// Distributed under the GNU GPL v2. For full terms please visit:
+// http://www.gnu.org/licenses/gpl.html
+//
+// Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef TRANSFER_HPP
+#define TRANSFER_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#include "socket/socket.hpp"
+#include "storage/file.hpp"
+
+#include <cstddef>
+#include <limits>
+#include <utility>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace app
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// \brief  zero-copy file to socket transfer
+///
+/// Moves data from a file to a socket inside the kernel. Regular files and block devices
+/// are sent with sendfile(2); pipes are spliced straight into the socket, and other
+/// sources (eg, character devices) are spliced through an intermediate pipe.
+///
+/// To run a transfer under an event loop, put the socket into non-blocking mode and call
+/// run(false) until done() returns true. Each time it stops short, wait for wait_events()
+/// on wait_id() (which may be the source rather than the socket) before calling it again.
+///
+class transfer
+{
+public:
+    static constexpr size_t all = std::numeric_limits<size_t>::max();
+
+public:
+    transfer() noexcept = default;
+    transfer(const transfer&) = delete;
+    transfer(transfer&& x) noexcept { swap(x); }
+
+    ////////////////////
+    /// \brief  construct transfer
+    /// \param  from source file
+    /// \param  to destination socket
+    /// \param  offset starting offset (ignored for non-seekable sources)
+    /// \param  length number of bytes to transfer (or until end of file)
+    ///
+    transfer(storage::file& from, app::socket& to, storage::offset offset = 0, size_t length = all);
+
+    ~transfer() { close(); }
+
+    void close() noexcept;
+
+    transfer& operator=(const transfer&) = delete;
+    transfer& operator=(transfer&& x) noexcept
+    {
+        swap(x);
+        return (*this);
+    }
+
+    void swap(transfer& x) noexcept
+    {
+        std::swap(_M_from, x._M_from);
+        std::swap(_M_to, x._M_to);
+        std::swap(_M_mode, x._M_mode);
+
+        std::swap(_M_offset, x._M_offset);
+        std::swap(_M_length, x._M_length);
+        std::swap(_M_count, x._M_count);
+        std::swap(_M_eof, x._M_eof);
+
+        std::swap(_M_pipe[0], x._M_pipe[0]);
+        std::swap(_M_pipe[1], x._M_pipe[1]);
+        std::swap(_M_pending, x._M_pending);
+
+        std::swap(_M_wait_fd, x._M_wait_fd);
+        std::swap(_M_wait_events, x._M_wait_events);
+    }
+
+    ////////////////////
+    /// \brief  transfer data
+    /// \param  wait block until done
+    /// \return number of bytes transferred by this call
+    ///
+    size_t run(bool wait = true);
+
+    bool done() const noexcept { return _M_eof || _M_count == _M_length; }
+
+    size_t count() const noexcept { return _M_count; }
+    size_t length() const noexcept { return _M_length; }
+    storage::offset offset() const noexcept { return _M_offset; }
+
+    ////////////////////
+    /// \brief  descriptor the transfer is waiting on, after run(false) stopped short
+    ///
+    /// Either the socket (for POLLOUT) or, for pipes and devices, the source (for POLLIN).
+    ///
+    int wait_id() const noexcept { return _M_wait_fd; }
+
+    ////////////////////
+    /// \brief  poll events to wait for on wait_id()
+    ///
+    short wait_events() const noexcept { return _M_wait_events; }
+
+private:
+    int _M_from = -1;
+    int _M_to = -1;
+
+    enum mode { by_sendfile, by_splice, by_pipe } _M_mode = by_sendfile;
+
+    storage::offset _M_offset = 0;
+    size_t _M_length = 0;
+    size_t _M_count = 0;
+    bool _M_eof = false;
+
+    int _M_pipe[2] = { -1, -1 };
+    size_t _M_pending = 0; // bytes sitting in the pipe
+
+    int _M_wait_fd = -1;
+    short _M_wait_events = 0;
+
+    void blocked(int fd, short events) noexcept { _M_wait_fd = fd; _M_wait_events = events; }
+
+    size_t run_sendfile(bool wait);
+    size_t run_splice(bool wait);
+    size_t run_pipe(bool wait);
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#endif // TRANSFER_HPP
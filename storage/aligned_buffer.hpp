@@ -0,0 +1,203 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2015 Dimitry Ishenko
+// Distributed under the GNU GPL v2. For full terms please visit:
+// http://www.gnu.org/licenses/gpl.html
+//
+// Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef ALIGNED_BUFFER_HPP
+#define ALIGNED_BUFFER_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#include "buffer.hpp"
+#include "errno_error.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <utility>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace storage
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace internal
+{
+
+struct free_delete { void operator()(void* x) const noexcept { std::free(x); } };
+
+inline void* aligned_alloc(size_t align, size_t n)
+{
+    void* x = nullptr;
+    if(posix_memalign(&x, align, n ? n : align)) throw std::bad_alloc();
+    return x;
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// \brief  allocator of aligned memory
+///
+/// For containers used with direct I/O (eg, std::vector<char, aligned_allocator<char>>),
+/// where alignment is only known at run time (see file::direct_alignment).
+///
+template<typename T>
+class aligned_allocator
+{
+public:
+    typedef T value_type;
+
+    template<typename U>
+    struct rebind { typedef aligned_allocator<U> other; };
+
+public:
+    explicit aligned_allocator(size_t align) noexcept: _M_align(std::max(align, alignof(T))) { }
+
+    template<typename U>
+    aligned_allocator(const aligned_allocator<U>& x) noexcept: _M_align(std::max(x.alignment(), alignof(T))) { }
+
+    T* allocate(size_t n) { return static_cast<T*>(internal::aligned_alloc(_M_align, n * sizeof(T))); }
+    void deallocate(T* x, size_t) noexcept { std::free(x); }
+
+    size_t alignment() const noexcept { return _M_align; }
+
+private:
+    size_t _M_align;
+};
+
+template<typename T, typename U>
+inline bool operator==(const aligned_allocator<T>& x, const aligned_allocator<U>& y) noexcept
+    { return x.alignment() == y.alignment(); }
+
+template<typename T, typename U>
+inline bool operator!=(const aligned_allocator<T>& x, const aligned_allocator<U>& y) noexcept
+    { return !(x == y); }
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// \brief  aligned byte buffer for direct I/O (open_opt::direct)
+///
+/// Like app::buffer, but its memory is aligned and its capacity is a multiple of the
+/// alignment, so that its contents can be padded to whole blocks in place
+/// (see file::write_direct).
+///
+class aligned_buffer
+{
+public:
+    aligned_buffer() noexcept = default;
+    aligned_buffer(const aligned_buffer&) = delete;
+    aligned_buffer(aligned_buffer&& x) noexcept { swap(x); }
+
+    ////////////////////
+    /// \brief  construct buffer
+    /// \param  align alignment (power of 2), eg file::direct_alignment()
+    ///
+    aligned_buffer(size_t capacity, size_t align): _M_align(align)
+    {
+        if(align == 0 || (align & (align - 1))) throw errno_error(std::make_error_code(std::errc::invalid_argument));
+        reserve(capacity);
+    }
+
+    aligned_buffer& operator=(const aligned_buffer&) = delete;
+    aligned_buffer& operator=(aligned_buffer&& x) noexcept
+    {
+        swap(x);
+        return (*this);
+    }
+
+    void swap(aligned_buffer& x) noexcept
+    {
+        std::swap(_M_data, x._M_data);
+        std::swap(_M_size, x._M_size);
+        std::swap(_M_capacity, x._M_capacity);
+        std::swap(_M_align, x._M_align);
+    }
+
+    char* data() noexcept { return _M_data.get(); }
+    const char* data() const noexcept { return _M_data.get(); }
+
+    size_t size() const noexcept { return _M_size; }
+    size_t capacity() const noexcept { return _M_capacity; }
+    size_t alignment() const noexcept { return _M_align; }
+    bool empty() const noexcept { return _M_size == 0; }
+
+    ////////////////////
+    /// \brief  size rounded up to a multiple of the alignment
+    ///
+    size_t padded() const noexcept { return round(_M_size); }
+
+    char* begin() noexcept { return data(); }
+    char* end() noexcept { return data() + _M_size; }
+
+    const char* begin() const noexcept { return data(); }
+    const char* end() const noexcept { return data() + _M_size; }
+
+    char& operator[](size_t n) noexcept { return data()[n]; }
+    const char& operator[](size_t n) const noexcept { return data()[n]; }
+
+    ////////////////////
+    /// \brief  grow capacity to at least n bytes (keeps contents)
+    ///
+    void reserve(size_t n)
+    {
+        n = round(n);
+        if(n > _M_capacity)
+        {
+            std::unique_ptr<char, internal::free_delete> data(static_cast<char*>(internal::aligned_alloc(_M_align, n)));
+            if(_M_size) std::memcpy(data.get(), _M_data.get(), _M_size);
+
+            _M_data = std::move(data);
+            _M_capacity = n;
+        }
+    }
+
+    ////////////////////
+    /// \brief  set size to n bytes (new bytes are left uninitialized)
+    ///
+    void resize(size_t n)
+    {
+        reserve(n);
+        _M_size = n;
+    }
+
+    void clear() noexcept { _M_size = 0; }
+
+    void assign(const void* x, size_t n)
+    {
+        _M_size = 0;
+        append(x, n);
+    }
+
+    void append(const void* x, size_t n)
+    {
+        if(_M_size + n > _M_capacity) reserve(std::max(_M_size + n, 2 * _M_capacity));
+        if(n) std::memcpy(_M_data.get() + _M_size, x, n);
+        _M_size += n;
+    }
+
+    ////////////////////
+    /// \brief  zero-fill bytes between size() and padded()
+    ///
+    void pad() noexcept { if(_M_data) std::memset(end(), 0, padded() - _M_size); }
+
+    operator app::span() noexcept { return app::span(data(), _M_size); }
+    operator app::const_span() const noexcept { return app::const_span(data(), _M_size); }
+
+private:
+    std::unique_ptr<char, internal::free_delete> _M_data;
+    size_t _M_size = 0;
+    size_t _M_capacity = 0;
+    size_t _M_align = 4096;
+
+    size_t round(size_t n) const noexcept { return (n + _M_align - 1) & ~(_M_align - 1); }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#endif // ALIGNED_BUFFER_HPP
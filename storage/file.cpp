@@ -6,20 +6,32 @@
 // Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
+#include "aligned_buffer.hpp"
 #include "errno_error.hpp"
 #include "file.hpp"
+#include "io_wait.hpp"
 
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <memory>
 
-#include <limits.h> // PATH_MAX
+#include <limits.h> // PATH_MAX, IOV_MAX
+#include <linux/fs.h> // BLKSSZGET
+#include <poll.h>
 #include <sys/ioctl.h>
-#include <sys/select.h>
+#include <sys/uio.h>
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 namespace storage
 {
 
+///////////////////////////////////////////////////////////////////////////////////////////////////
+using app::internal::clock;
+using app::internal::deadline;
+using app::internal::poll_until;
+using app::internal::advance;
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 file::file(const std::string& name, storage::open open, open_opt opt, storage::perm perm)
@@ -39,31 +51,280 @@ void file::close() noexcept
             ::close(_M_fd);
         _M_fd = invalid;
     }
+
+    _M_buffer.reset();
+    _M_pos = _M_end = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t file::drain(void* buffer, size_t max) noexcept
+{
+    size_t count = std::min(max, buffered());
+    if(count)
+    {
+        std::memcpy(buffer, _M_buffer.get() + _M_pos, count);
+        _M_pos += count;
+    }
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void file::unread()
+{
+    // move file position back to where the reader is, so that
+    // writes go to the right place; streams keep their buffer
+    if(buffered())
+    {
+        if(::lseek(_M_fd, -static_cast<storage::offset>(buffered()), SEEK_CUR) == -1)
+        {
+            if(errno == ESPIPE) return;
+            throw errno_error();
+        }
+        _M_pos = _M_end = 0;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void file::set_buffer(size_t size)
+{
+    size = std::max(size, buffered());
+    if(size == 0) size = 1;
+
+    if(_M_buffer)
+    {
+        std::unique_ptr<char[]> buffer(new char[size]);
+        std::memcpy(buffer.get(), _M_buffer.get() + _M_pos, buffered());
+
+        _M_end = buffered();
+        _M_pos = 0;
+        _M_buffer = std::move(buffer);
+    }
+    _M_capacity = size;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 size_t file::write(const void* buffer, size_t n)
 {
+    unread();
+
     ssize_t count = ::write(_M_fd, buffer, n);
     if(count == -1) throw errno_error();
 
     return count;
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void file::write_all(const app::const_span* spans, size_t n, std::chrono::seconds s, std::chrono::nanoseconds ns)
+{
+    if(n == 0) return;
+    if(n > IOV_MAX) throw errno_error(std::make_error_code(std::errc::invalid_argument));
+
+    clock::time_point time = deadline(s, ns);
+    unread();
+
+    iovec iov[IOV_MAX];
+    for(size_t i = 0; i < n; ++i)
+    {
+        iov[i].iov_base = const_cast<void*>(spans[i].data);
+        iov[i].iov_len = spans[i].size;
+    }
+
+    iovec* next = iov;
+    for(advance(next, n, 0); n; )
+    {
+        ssize_t count = ::writev(_M_fd, next, n);
+        if(count == -1)
+        {
+            if(errno == EINTR) continue;
+            if(errno != EAGAIN && errno != EWOULDBLOCK) throw errno_error();
+
+            if(!poll_until(_M_fd, POLLOUT, time)) throw errno_error(std::make_error_code(std::errc::timed_out));
+            continue;
+        }
+        advance(next, n, count);
+
+        if(n && clock::now() >= time) throw errno_error(std::make_error_code(std::errc::timed_out));
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t file::read_exact(const app::span* spans, size_t n, std::chrono::seconds s, std::chrono::nanoseconds ns)
+{
+    if(n == 0) return 0;
+    if(n > IOV_MAX) throw errno_error(std::make_error_code(std::errc::invalid_argument));
+
+    clock::time_point time = deadline(s, ns);
+
+    iovec iov[IOV_MAX];
+    for(size_t i = 0; i < n; ++i)
+    {
+        iov[i].iov_base = spans[i].data;
+        iov[i].iov_len = spans[i].size;
+    }
+
+    size_t total = 0;
+
+    iovec* next = iov;
+    for(advance(next, n, 0); n && buffered(); )
+    {
+        size_t count = drain(next->iov_base, next->iov_len);
+        total += count;
+        advance(next, n, count);
+    }
+
+    while(n)
+    {
+        ssize_t count = ::readv(_M_fd, next, n);
+        if(count == -1)
+        {
+            if(errno == EINTR) continue;
+            if(errno != EAGAIN && errno != EWOULDBLOCK) throw errno_error();
+
+            if(!poll_until(_M_fd, POLLIN, time)) throw errno_error(std::make_error_code(std::errc::timed_out));
+            continue;
+        }
+        if(count == 0) break; // end of file
+
+        total += count;
+        advance(next, n, count);
+
+        if(n && clock::now() >= time) throw errno_error(std::make_error_code(std::errc::timed_out));
+    }
+    return total;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t file::read_at(storage::offset offset, const app::span* spans, size_t n, io_opt opt)
+{
+    if(n == 0) return 0;
+    if(n > IOV_MAX) throw errno_error(std::make_error_code(std::errc::invalid_argument));
+
+    iovec iov[IOV_MAX];
+    for(size_t i = 0; i < n; ++i)
+    {
+        iov[i].iov_base = spans[i].data;
+        iov[i].iov_len = spans[i].size;
+    }
+
+    for(;;)
+    {
+        ssize_t count;
+        if(opt == io_opt::none)
+            count = n == 1 ? ::pread(_M_fd, iov[0].iov_base, iov[0].iov_len, offset) : ::preadv(_M_fd, iov, n, offset);
+        else count = ::preadv2(_M_fd, iov, n, offset, static_cast<int>(opt));
+
+        if(count != -1) return count;
+
+        if(errno == EINTR) continue;
+        if(errno == EAGAIN && (opt && io_opt::no_wait)) return 0;
+
+        throw errno_error();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t file::write_at(storage::offset offset, const app::const_span* spans, size_t n, io_opt opt)
+{
+    if(n == 0) return 0;
+    if(n > IOV_MAX) throw errno_error(std::make_error_code(std::errc::invalid_argument));
+
+    iovec iov[IOV_MAX];
+    for(size_t i = 0; i < n; ++i)
+    {
+        iov[i].iov_base = const_cast<void*>(spans[i].data);
+        iov[i].iov_len = spans[i].size;
+    }
+
+    for(;;)
+    {
+        ssize_t count;
+        if(opt == io_opt::none)
+            count = n == 1 ? ::pwrite(_M_fd, iov[0].iov_base, iov[0].iov_len, offset) : ::pwritev(_M_fd, iov, n, offset);
+        else count = ::pwritev2(_M_fd, iov, n, offset, static_cast<int>(opt));
+
+        if(count != -1) return count;
+
+        if(errno == EINTR) continue;
+        if(errno == EAGAIN && (opt && io_opt::no_wait)) return 0;
+
+        throw errno_error();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t file::direct_alignment()
+{
+#if defined(STATX_DIOALIGN)
+    struct statx sx;
+    if(statx(_M_fd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &sx) == 0 && (sx.stx_mask & STATX_DIOALIGN) && sx.stx_dio_offset_align)
+        return std::max(sx.stx_dio_mem_align, sx.stx_dio_offset_align);
+#endif
+
+    struct stat x;
+    if(fstat(_M_fd, &x)) throw errno_error();
+
+    int size = 0;
+    if(S_ISBLK(x.st_mode) && ioctl(_M_fd, BLKSSZGET, &size) == 0 && size > 0) return size;
+
+    return x.st_blksize > 0 ? x.st_blksize : 4096;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t file::write_direct(storage::offset offset, storage::aligned_buffer& buffer, io_opt opt)
+{
+    if(offset % buffer.alignment()) throw errno_error(std::make_error_code(std::errc::invalid_argument));
+    buffer.pad();
+
+    size_t done = 0;
+    while(done < buffer.padded())
+    {
+        size_t count = write_at(offset + done, buffer.data() + done, buffer.padded() - done, opt);
+        if(count == 0) break; // io_opt::no_wait
+
+        done += count;
+    }
+    return std::min(done, buffer.size());
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t file::read_direct(storage::offset offset, storage::aligned_buffer& buffer, size_t n, io_opt opt)
+{
+    if(offset % buffer.alignment()) throw errno_error(std::make_error_code(std::errc::invalid_argument));
+
+    buffer.resize(n);
+    size_t count = read_at(offset, buffer.data(), buffer.padded(), opt);
+
+    buffer.resize(std::min(count, n));
+    return buffer.size();
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 size_t file::read(std::string& string, size_t max, bool wait)
 {
-    std::unique_ptr<char[]> buffer(new char[max + 1]);
-    size_t count = read(buffer.get(), max, wait);
-    buffer[count] = '\0';
+    string.resize(max);
+
+    size_t count = read(&string[0], max, wait);
+    string.resize(count);
+
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t file::read(app::buffer& buffer, size_t max, bool wait)
+{
+    buffer.resize(max);
+
+    size_t count = read(buffer.data(), max, wait);
+    buffer.resize(count);
 
-    string.assign(buffer.get(), count);
     return count;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 size_t file::read(void* buffer, size_t max, bool wait)
 {
+    if(buffered()) return drain(buffer, max);
+
     ssize_t count = 0;
     if(wait || can_read(std::chrono::seconds(0))) count = ::read(_M_fd, buffer, max);
 
@@ -72,61 +333,110 @@ size_t file::read(void* buffer, size_t max, bool wait)
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
-std::string file::readline(bool wait, char delim)
+bool file::getline(app::const_span& line, bool wait, char delim)
 {
-    std::string string;
+    if(!_M_buffer) _M_buffer.reset(new char[_M_capacity]);
 
-    for(char c;;)
+    for(size_t done = 0;;) // bytes searched so far
     {
-        size_t n = read(&c, sizeof(c), wait);
-        if(n == 0 || c == delim) break;
-        string += c;
+        char* data = _M_buffer.get() + _M_pos;
+        if(auto p = static_cast<char*>(std::memchr(data + done, delim, buffered() - done)))
+        {
+            line = app::const_span(data, p - data);
+            _M_pos += p - data + 1;
+            return true;
+        }
+        done = buffered();
+
+        if(!wait && !can_read(std::chrono::seconds(0))) return false;
+
+        // make room
+        if(_M_pos)
+        {
+            std::memmove(_M_buffer.get(), data, buffered());
+            _M_end -= _M_pos;
+            _M_pos = 0;
+        }
+        if(_M_end == _M_capacity) set_buffer(_M_capacity * 2);
+
+        ssize_t count = ::read(_M_fd, _M_buffer.get() + _M_end, _M_capacity - _M_end);
+        if(count == -1)
+        {
+            if(errno == EINTR) continue;
+            if(errno != EAGAIN && errno != EWOULDBLOCK) throw errno_error();
+
+            if(!wait) return false;
+            can_read(std::chrono::seconds(-1));
+            continue;
+        }
+
+        if(count == 0) // end of file
+        {
+            if(!wait || !buffered()) return false;
+
+            line = app::const_span(_M_buffer.get(), _M_end);
+            _M_pos = _M_end;
+            return true;
+        }
+        _M_end += count;
     }
+}
 
-    return string;
+///////////////////////////////////////////////////////////////////////////////////////////////////
+std::string file::readline(bool wait, char delim)
+{
+    app::const_span line;
+    return getline(line, wait, delim) ? std::string(static_cast<const char*>(line.data), line.size) : std::string();
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 bool file::getline(std::string& string, bool wait, char delim)
 {
-    string.clear();
-
-    for(char c;;)
+    app::const_span line;
+    if(getline(line, wait, delim))
     {
-        size_t n = read(&c, sizeof(c), wait);
-        if(n == 0) return string.size();
-        if(c == delim) return true;
-        string += c;
+        string.assign(static_cast<const char*>(line.data), line.size);
+        return true;
     }
+
+    string.clear();
+    return false;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 bool file::eof()
 {
-    offset n = tell();
-    offset e = seek(0, origin::end);
-
-    seek(n);
-    return n == e;
+    return !buffered() && tell() >= size();
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 offset file::seek(storage::offset offset, storage::origin origin)
 {
+    if(origin == origin::cur) offset -= buffered();
+
     storage::offset n = ::lseek(_M_fd, offset, static_cast<int>(origin));
     if(n == -1) throw errno_error();
 
+    _M_pos = _M_end = 0;
     return n;
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////
+offset file::tell()
+{
+    storage::offset n = ::lseek(_M_fd, 0, SEEK_CUR);
+    if(n == -1) throw errno_error();
+
+    return n - buffered();
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 offset file::size()
 {
-    offset n = tell();
-    offset e = seek(0, origin::end);
+    struct stat x;
+    if(fstat(_M_fd, &x)) throw errno_error();
 
-    seek(n);
-    return e;
+    return x.st_size;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -136,16 +446,25 @@ void file::truncate(storage::offset length)
     if(val == -1) throw errno_error();
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void file::sync()
+{
+    if(fsync(_M_fd)) throw errno_error();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void file::sync_data()
+{
+    if(fdatasync(_M_fd)) throw errno_error();
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 bool file::can_read(std::chrono::seconds s, std::chrono::nanoseconds n)
 {
     timespec time = { static_cast<std::time_t>(s.count()), static_cast<long>(n.count()) };
+    pollfd fd = { _M_fd, POLLIN, 0 };
 
-    fd_set fds;
-    FD_ZERO(&fds);
-    FD_SET(_M_fd, &fds);
-
-    int count = pselect(_M_fd+1, &fds, 0, 0, &time, nullptr);
+    int count = ppoll(&fd, 1, s.count() < 0 ? nullptr : &time, nullptr);
     if(count == -1) throw errno_error();
 
     return count;
@@ -155,12 +474,9 @@ bool file::can_read(std::chrono::seconds s, std::chrono::nanoseconds n)
 bool file::can_write(std::chrono::seconds s, std::chrono::nanoseconds n)
 {
     timespec time = { static_cast<std::time_t>(s.count()), static_cast<long>(n.count()) };
+    pollfd fd = { _M_fd, POLLOUT, 0 };
 
-    fd_set fds;
-    FD_ZERO(&fds);
-    FD_SET(_M_fd, &fds);
-
-    int count = pselect(_M_fd+1, 0, &fds, 0, &time, nullptr);
+    int count = ppoll(&fd, 1, s.count() < 0 ? nullptr : &time, nullptr);
     if(count == -1) throw errno_error();
 
     return count;
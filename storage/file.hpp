@@ -10,16 +10,20 @@
 #define FILE_HPP
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
+#include "buffer.hpp"
 #include "enum.hpp"
 #include "perm.hpp"
 
 #include <chrono>
 #include <cstdint>
+#include <initializer_list>
+#include <memory>
 #include <string>
 
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -58,6 +62,7 @@ enum class open_opt
 {
     none      = 0,
     create    = O_CREAT,
+    exclusive = O_EXCL,
     trunc     = O_TRUNC,
     append    = O_APPEND,
     sync      = O_SYNC,
@@ -66,6 +71,17 @@ enum class open_opt
 };
 DECLARE_OPERATOR(open_opt)
 
+///////////////////////////////////////////////////////////////////////////////////////////////////
+enum class io_opt
+{
+    none          = 0,
+    no_wait       = RWF_NOWAIT, //< fail instead of blocking (eg, if data is not in the page cache)
+    dsync         = RWF_DSYNC,  //< per-write O_DSYNC
+    sync          = RWF_SYNC,   //< per-write O_SYNC
+    high_priority = RWF_HIPRI,  //< poll for completion (O_DIRECT only)
+};
+DECLARE_OPERATOR(io_opt)
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 enum class origin
 {
@@ -74,6 +90,9 @@ enum class origin
     end = SEEK_END,
 };
 
+///////////////////////////////////////////////////////////////////////////////////////////////////
+class aligned_buffer;
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 class file
 {
@@ -106,25 +125,185 @@ public:
     void swap(file& x) noexcept
     {
         std::swap(_M_fd, x._M_fd);
+
+        std::swap(_M_buffer, x._M_buffer);
+        std::swap(_M_capacity, x._M_capacity);
+        std::swap(_M_pos, x._M_pos);
+        std::swap(_M_end, x._M_end);
     }
 
     size_t write(const std::string& string)
         { return write(string.data(), string.size()); }
     size_t write(const void* buffer, size_t n);
 
+    ////////////////////
+    /// \brief write all data, retrying partial writes
+    /// \param x overall time limit (negative = no limit)
+    ///
+    /// Retries on EINTR and waits for the file to become writable on EAGAIN.
+    /// Several buffers are written with writev. Throws errc::timed_out if the time
+    /// limit expires; some of the data may have been written by then.
+    ///
+    /// NB: the time limit is only checked between writes, so it is not enforced
+    /// on files opened without open_opt::non_block.
+    ///
+    template<typename Rep, typename Period>
+    void write_all(const app::const_span* spans, size_t n, const std::chrono::duration<Rep, Period>& x)
+    {
+        std::chrono::seconds s = std::chrono::duration_cast<std::chrono::seconds>(x);
+        std::chrono::nanoseconds ns = std::chrono::duration_cast<std::chrono::nanoseconds>(x - s);
+        write_all(spans, n, s, ns);
+    }
+
+    template<typename Rep, typename Period>
+    void write_all(std::initializer_list<app::const_span> spans, const std::chrono::duration<Rep, Period>& x)
+        { write_all(spans.begin(), spans.size(), x); }
+    template<typename Rep, typename Period>
+    void write_all(const void* buffer, size_t n, const std::chrono::duration<Rep, Period>& x)
+        { app::const_span span(buffer, n); write_all(&span, 1, x); }
+    template<typename Rep, typename Period>
+    void write_all(const std::string& string, const std::chrono::duration<Rep, Period>& x)
+        { write_all(string.data(), string.size(), x); }
+
+    void write_all(const app::const_span* spans, size_t n) { write_all(spans, n, std::chrono::seconds(-1)); }
+    void write_all(std::initializer_list<app::const_span> spans) { write_all(spans, std::chrono::seconds(-1)); }
+    void write_all(const void* buffer, size_t n) { write_all(buffer, n, std::chrono::seconds(-1)); }
+    void write_all(const std::string& string) { write_all(string, std::chrono::seconds(-1)); }
+
+    ////////////////////
+    /// \brief read exactly n bytes
+    /// \param x overall time limit (negative = no limit)
+    /// \return n, or less on end of file
+    ///
+    /// Retries on EINTR and waits for the file to become readable on EAGAIN.
+    /// Several buffers are filled with readv. Throws errc::timed_out if the time
+    /// limit expires; some of the data may have been read by then.
+    ///
+    template<typename Rep, typename Period>
+    size_t read_exact(const app::span* spans, size_t n, const std::chrono::duration<Rep, Period>& x)
+    {
+        std::chrono::seconds s = std::chrono::duration_cast<std::chrono::seconds>(x);
+        std::chrono::nanoseconds ns = std::chrono::duration_cast<std::chrono::nanoseconds>(x - s);
+        return read_exact(spans, n, s, ns);
+    }
+
+    template<typename Rep, typename Period>
+    size_t read_exact(std::initializer_list<app::span> spans, const std::chrono::duration<Rep, Period>& x)
+        { return read_exact(spans.begin(), spans.size(), x); }
+    template<typename Rep, typename Period>
+    size_t read_exact(void* buffer, size_t n, const std::chrono::duration<Rep, Period>& x)
+        { app::span span(buffer, n); return read_exact(&span, 1, x); }
+
+    size_t read_exact(const app::span* spans, size_t n) { return read_exact(spans, n, std::chrono::seconds(-1)); }
+    size_t read_exact(std::initializer_list<app::span> spans) { return read_exact(spans, std::chrono::seconds(-1)); }
+    size_t read_exact(void* buffer, size_t n) { return read_exact(buffer, n, std::chrono::seconds(-1)); }
+
     size_t read(std::string& string, size_t max, bool wait = true);
+    size_t read(app::buffer& buffer, size_t max, bool wait = true);
     size_t read(void* buffer, size_t max, bool wait = true);
 
+    ////////////////////
+    /// \brief read at offset, without moving file position
+    /// \return number of bytes read, or 0 on end of file (or if io_opt::no_wait
+    ///         is given and the read would block)
+    ///
+    /// Several threads can read and write the same file at different offsets concurrently.
+    /// Several buffers are filled with preadv.
+    ///
+    size_t read_at(storage::offset offset, void* buffer, size_t n, io_opt opt = io_opt::none)
+        { app::span span(buffer, n); return read_at(offset, &span, 1, opt); }
+    size_t read_at(storage::offset offset, std::initializer_list<app::span> spans, io_opt opt = io_opt::none)
+        { return read_at(offset, spans.begin(), spans.size(), opt); }
+    size_t read_at(storage::offset offset, const app::span* spans, size_t n, io_opt opt = io_opt::none);
+
+    ////////////////////
+    /// \brief write at offset, without moving file position
+    /// \return number of bytes written, or 0 if io_opt::no_wait is given and
+    ///         the write would block
+    ///
+    /// Several buffers are written with pwritev.
+    ///
+    size_t write_at(storage::offset offset, const std::string& string, io_opt opt = io_opt::none)
+        { return write_at(offset, string.data(), string.size(), opt); }
+    size_t write_at(storage::offset offset, const void* buffer, size_t n, io_opt opt = io_opt::none)
+        { app::const_span span(buffer, n); return write_at(offset, &span, 1, opt); }
+    size_t write_at(storage::offset offset, std::initializer_list<app::const_span> spans, io_opt opt = io_opt::none)
+        { return write_at(offset, spans.begin(), spans.size(), opt); }
+    size_t write_at(storage::offset offset, const app::const_span* spans, size_t n, io_opt opt = io_opt::none);
+
+    ////////////////////
+    /// \brief get alignment of buffers, offsets and lengths for direct I/O
+    ///
+    /// Uses statx (STATX_DIOALIGN) if the kernel reports it, or the logical block
+    /// size (BLKSSZGET) for block devices. Otherwise, falls back to the preferred
+    /// I/O block size (st_blksize), which is a multiple of the logical block size.
+    ///
+    size_t direct_alignment();
+
+    ////////////////////
+    /// \brief write buffer at offset with direct I/O (open_opt::direct)
+    /// \return number of bytes of the buffer written (not counting padding)
+    ///
+    /// The buffer is zero-padded in place to a multiple of its alignment, which must
+    /// satisfy direct_alignment(), and so must the offset. The file may thus end up
+    /// longer than the data; truncate it to its real size when done.
+    ///
+    size_t write_direct(storage::offset offset, storage::aligned_buffer& buffer, io_opt opt = io_opt::none);
+
+    ////////////////////
+    /// \brief read up to n bytes at offset with direct I/O (open_opt::direct)
+    /// \return number of bytes read (buffer is resized accordingly)
+    ///
+    /// The read is rounded up to a multiple of the buffer alignment, but
+    /// the buffer size is clipped to n.
+    ///
+    size_t read_direct(storage::offset offset, storage::aligned_buffer& buffer, size_t n, io_opt opt = io_opt::none);
+
+    ////////////////////
+    /// \brief read line into the read buffer
+    /// \param line view of the line (without delimiter), valid until the next read
+    /// \return false on end of file, or if there is no complete line and wait is false
+    ///
+    /// Reads the file in blocks and searches them with memchr. With wait = false, only
+    /// complete lines are returned: an incomplete last line stays buffered until the
+    /// rest of it arrives (or getline is called with wait = true at end of file).
+    /// When reading a non-blocking file from a reactor, call it until it returns false,
+    /// as more lines may already be buffered.
+    ///
+    /// The buffer grows to fit lines longer than its size.
+    ///
+    bool getline(app::const_span& line, bool wait = true, char delim = '\n');
+
     std::string readline(bool wait = true, char delim = '\n');
     bool getline(std::string& string, bool wait = true, char delim = '\n');
     bool eof();
 
+    ////////////////////
+    /// \brief set read buffer size used by getline and readline (default 8KiB)
+    ///
+    void set_buffer(size_t size);
+
+    ////////////////////
+    /// \brief number of bytes read from the file, but not yet consumed
+    ///
+    /// Buffered data is returned by read before reading the file again, and
+    /// seek/tell account for it.
+    ///
+    size_t buffered() const noexcept { return _M_end - _M_pos; }
+
     storage::offset seek(storage::offset, storage::origin = origin::beg);
-    storage::offset tell() { return seek(0, origin::cur); }
+    storage::offset tell();
     storage::offset size();
 
     void truncate(storage::offset length);
 
+    ////////////////////
+    /// \brief flush data and metadata (fsync), or only data and the metadata
+    ///        needed to read it back (fdatasync) to storage
+    ///
+    void sync();
+    void sync_data();
+
     template<typename Rep, typename Period>
     bool can_read(const std::chrono::duration<Rep, Period>& x)
     {
@@ -157,7 +336,17 @@ protected:
     bool can_read(std::chrono::seconds, std::chrono::nanoseconds);
     bool can_write(std::chrono::seconds, std::chrono::nanoseconds);
 
+    void write_all(const app::const_span* spans, size_t n, std::chrono::seconds, std::chrono::nanoseconds);
+    size_t read_exact(const app::span* spans, size_t n, std::chrono::seconds, std::chrono::nanoseconds);
+
     int _M_control(unsigned long request, void* buffer);
+
+private:
+    std::unique_ptr<char[]> _M_buffer;
+    size_t _M_capacity = 8192, _M_pos = 0, _M_end = 0;
+
+    size_t drain(void* buffer, size_t max) noexcept;
+    void unread();
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,396 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2015 Dimitry Ishenko
+// Distributed under the GNU GPL v2. For full terms please visit:
+// http://www.gnu.org/licenses/gpl.html
+//
+// Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#include "errno_error.hpp"
+#include "journal.hpp"
+#include "mapped_file.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <dirent.h>
+#include <limits.h> // IOV_MAX
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace storage
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+constexpr size_t journal::header_size;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+uint32_t crc32(const void* data, size_t n, uint32_t crc) noexcept
+{
+    static const struct table
+    {
+        table() noexcept
+        {
+            for(uint32_t i = 0; i < 256; ++i)
+            {
+                uint32_t x = i;
+                for(int k = 0; k < 8; ++k) x = (x >> 1) ^ (0xedb88320 & -(x & 1));
+                value[i] = x;
+            }
+        }
+        uint32_t value[256];
+    }
+    t;
+
+    auto p = static_cast<const unsigned char*>(data);
+
+    crc = ~crc;
+    while(n--) crc = t.value[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace
+{
+
+// record header:
+//   uint32_t size;  size of data
+//   uint32_t crc;   crc32 of data, size and seq
+//   uint64_t seq;   sequence number
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+uint32_t checksum(const char* header, const void* data, size_t n) noexcept
+{
+    uint32_t crc = crc32(data, n);
+    crc = crc32(header, 4, crc);
+    return crc32(header + 8, 8, crc);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// walk valid records of a segment, starting with sequence number n;
+// func returns false to stop; returns size of the valid part
+size_t scan(app::const_span segment, journal::seq& n, const std::function<bool(journal::seq, app::const_span)>& func)
+{
+    auto data = static_cast<const char*>(segment.data);
+    size_t pos = 0;
+
+    while(segment.size - pos >= journal::header_size)
+    {
+        const char* header = data + pos;
+
+        uint32_t size, crc;
+        journal::seq seq;
+        std::memcpy(&size, header, 4);
+        std::memcpy(&crc, header + 4, 4);
+        std::memcpy(&seq, header + 8, 8);
+
+        if(seq != n || size > segment.size - pos - journal::header_size) break;
+        if(checksum(header, header + journal::header_size, size) != crc) break;
+
+        if(func && !func(seq, app::const_span(header + journal::header_size, size))) break;
+
+        pos += journal::header_size + size;
+        ++n;
+    }
+    return pos;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// NB: d_type may be DT_UNKNOWN, so go by name only
+bool is_segment(const std::string& name)
+{
+    return name.size() == 20
+        && name.find_first_not_of("0123456789abcdef") == 16 && name.compare(16, 4, ".log") == 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// segment names in order; zero-padded hex names sort by value as plain strings
+// (entry::get is not used, as it is not reentrant)
+std::vector<std::string> segments(const std::string& path)
+{
+    std::vector<std::string> names;
+
+    DIR* dir = opendir(path.data());
+    if(!dir) throw errno_error();
+
+    errno = 0;
+    while(dirent* e = readdir(dir))
+        if(is_segment(e->d_name)) names.push_back(e->d_name);
+
+    int code = errno;
+    closedir(dir);
+    if(code) throw errno_error(std::error_code(code, std::generic_category()));
+
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+journal::seq first(const std::string& name)
+{
+    return std::strtoull(name.data(), nullptr, 16);
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+journal::journal(const std::string& path, size_t segment_size):
+    _M_path(path), _M_segment_size(segment_size), _M_durable(0)
+{
+    recover();
+    _M_thread = std::thread(&journal::run, this);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+journal::~journal()
+{
+    {
+        std::lock_guard<std::mutex> lock(_M_mutex);
+        _M_stop = true;
+    }
+    _M_queued.notify_one();
+    _M_thread.join();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+std::string journal::segment(seq n) const
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "/%016" PRIx64 ".log", n);
+    return _M_path + name;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void journal::recover()
+{
+    if(!exists(_M_path)) mkdir(_M_path);
+
+    std::vector<std::string> names = segments(_M_path);
+    if(names.empty())
+    {
+        roll(_M_next);
+        return;
+    }
+
+    std::string name = _M_path + "/" + names.back();
+    seq n = first(names.back());
+
+    size_t size = scan(storage::mapped_file(name).view(), n, nullptr);
+
+    _M_file = storage::file(name, open::read_write);
+    if(static_cast<storage::offset>(size) < _M_file.size())
+    {
+        _M_file.truncate(size);
+        _M_file.sync_data();
+    }
+
+    _M_offset = size;
+    _M_next = n;
+    _M_durable.store(n - 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void journal::roll(seq n)
+{
+    if(_M_file.is_open()) _M_file.sync_data();
+
+    _M_file = storage::file(segment(n), open::read_write, open_opt::create | open_opt::exclusive);
+    _M_offset = 0;
+
+    // make the new entry itself durable
+    storage::file(_M_path, open::read).sync();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+journal::seq journal::enqueue(const void* data, size_t n, std::unique_ptr<std::promise<seq>> promise)
+{
+    if(n > UINT32_MAX) throw errno_error(std::make_error_code(std::errc::message_size));
+
+    record r;
+    r.data.assign(static_cast<const char*>(data), n);
+    r.promise = std::move(promise);
+
+    uint32_t size = n, crc = crc32(data, n);
+    std::memcpy(r.header, &size, 4);
+
+    seq x;
+    bool notify;
+    {
+        std::lock_guard<std::mutex> lock(_M_mutex);
+        if(_M_error) std::rethrow_exception(_M_error);
+
+        x = r.n = _M_next++;
+        std::memcpy(r.header + 8, &r.n, 8);
+
+        crc = crc32(r.header, 4, crc);
+        crc = crc32(r.header + 8, 8, crc);
+        std::memcpy(r.header + 4, &crc, 4);
+
+        notify = _M_queue.empty();
+        _M_queue.push_back(std::move(r));
+    }
+    if(notify) _M_queued.notify_one();
+
+    return x;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+journal::seq journal::append(const void* data, size_t n)
+{
+    return enqueue(data, n, nullptr);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+std::future<journal::seq> journal::commit(const void* data, size_t n)
+{
+    std::unique_ptr<std::promise<seq>> promise(new std::promise<seq>());
+    std::future<seq> future = promise->get_future();
+
+    enqueue(data, n, std::move(promise));
+    return future;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+journal::seq journal::last()
+{
+    std::lock_guard<std::mutex> lock(_M_mutex);
+    return _M_next - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void journal::wait(seq n)
+{
+    std::unique_lock<std::mutex> lock(_M_mutex);
+    _M_synced.wait(lock, [&]() { return durable() >= n || _M_error; });
+
+    if(durable() < n) std::rethrow_exception(_M_error);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool journal::wait_for(seq n, std::chrono::seconds s, std::chrono::nanoseconds ns)
+{
+    std::unique_lock<std::mutex> lock(_M_mutex);
+    if(!_M_synced.wait_for(lock, s + ns, [&]() { return durable() >= n || _M_error; })) return false;
+
+    if(durable() < n) std::rethrow_exception(_M_error);
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void journal::run()
+{
+    std::vector<record> batch;
+    for(;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_M_mutex);
+            _M_queued.wait(lock, [&]() { return _M_stop || _M_queue.size(); });
+
+            if(_M_queue.empty()) return;
+            batch.swap(_M_queue);
+        }
+
+        try
+        {
+            write(batch);
+            {
+                std::lock_guard<std::mutex> lock(_M_mutex);
+                _M_durable.store(batch.back().n, std::memory_order_release);
+            }
+            _M_synced.notify_all();
+
+            for(auto& r : batch) if(r.promise) r.promise->set_value(r.n);
+        }
+        catch(...)
+        {
+            // fail this batch and everything queued after it
+            {
+                std::lock_guard<std::mutex> lock(_M_mutex);
+                _M_error = std::current_exception();
+
+                for(auto& r : _M_queue) batch.push_back(std::move(r));
+                _M_queue.clear();
+            }
+            _M_synced.notify_all();
+
+            for(auto& r : batch) if(r.promise) r.promise->set_exception(_M_error);
+            return;
+        }
+        batch.clear();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void journal::write(std::vector<record>& batch)
+{
+    std::vector<app::const_span> spans;
+    spans.reserve(2 * batch.size());
+
+    for(size_t i = 0; i < batch.size(); )
+    {
+        // records that fit into the current segment (at least one)
+        size_t bytes = 0;
+        for(spans.clear(); i < batch.size(); ++i)
+        {
+            size_t size = header_size + batch[i].data.size();
+            if(_M_offset + bytes > 0 && _M_offset + bytes + size > _M_segment_size) break;
+
+            spans.emplace_back(batch[i].header, header_size);
+            spans.emplace_back(batch[i].data);
+            bytes += size;
+        }
+
+        for(size_t k = 0; k < spans.size(); )
+        {
+            size_t count = _M_file.write_at(_M_offset, &spans[k], std::min<size_t>(spans.size() - k, IOV_MAX));
+            _M_offset += count;
+
+            for(; k < spans.size() && count >= spans[k].size; ++k) count -= spans[k].size;
+            if(count)
+            {
+                spans[k].data = static_cast<const char*>(spans[k].data) + count;
+                spans[k].size -= count;
+            }
+        }
+
+        if(i < batch.size()) roll(batch[i].n);
+    }
+
+    _M_file.sync_data();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void journal::replay(seq n, const callback& func)
+{
+    seq limit = durable();
+    std::vector<std::string> names = segments(_M_path);
+
+    for(size_t i = 0; i < names.size(); ++i)
+    {
+        if(i + 1 < names.size() && first(names[i + 1]) <= n) continue;
+
+        seq next = first(names[i]);
+        if(next > limit) break;
+
+        bool done = false;
+        scan(storage::mapped_file(_M_path + "/" + names[i]).view(), next,
+            [&](seq x, app::const_span data)
+            {
+                if(x > limit)
+                {
+                    done = true;
+                    return false;
+                }
+
+                if(x >= n) func(x, data);
+                return true;
+            }
+        );
+        if(done) break;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+}
@@ -0,0 +1,166 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2015 Dimitry Ishenko
+// Distributed under the GNU GPL v2. For full terms please visit:
+// http://www.gnu.org/licenses/gpl.html
+//
+// Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef JOURNAL_HPP
+#define JOURNAL_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#include "buffer.hpp"
+#include "file.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace storage
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// \brief  append-only write-ahead log with group commit
+///
+/// Records are queued by append and written by a flusher thread, which gathers everything
+/// queued since its last write into a single pwritev followed by one fdatasync. Each record
+/// gets a sequence number; it is durable once durable() has reached it.
+///
+/// The log is kept in a directory as a series of segment files, named after the sequence
+/// number of their first record in hex, each up to segment_size bytes. Records carry a CRC32
+/// of their contents. On open, the last segment is scanned and anything after the last
+/// valid record (eg, torn by a crash) is cut off.
+///
+class journal
+{
+public:
+    typedef uint64_t seq;
+    typedef std::function<void(seq, app::const_span)> callback;
+
+    static constexpr size_t header_size = 16;
+
+public:
+    ////////////////////
+    /// \brief  open journal in directory path (created if it does not exist)
+    /// \param  segment_size size at which a new segment is started
+    ///
+    explicit journal(const std::string& path, size_t segment_size = 64 << 20);
+    journal(const journal&) = delete;
+    journal(journal&&) = delete;
+
+    ////////////////////
+    /// \brief  write out queued records and stop the flusher thread
+    ///
+    ~journal();
+
+    journal& operator=(const journal&) = delete;
+    journal& operator=(journal&&) = delete;
+
+    ////////////////////
+    /// \brief  queue record for writing
+    /// \return sequence number of the record
+    ///
+    /// Does not block. Use wait (or commit) to find out when the record is durable.
+    /// Throws the error that stopped the flusher thread, if any.
+    ///
+    seq append(const void* data, size_t n);
+    seq append(app::const_span x) { return append(x.data, x.size); }
+
+    ////////////////////
+    /// \brief  queue record for writing
+    /// \return future, which is set to the record's sequence number once it is durable
+    ///         (or to the exception that stopped the flusher thread)
+    ///
+    std::future<seq> commit(const void* data, size_t n);
+    std::future<seq> commit(app::const_span x) { return commit(x.data, x.size); }
+
+    ////////////////////
+    /// \brief  wait until record n is durable
+    ///
+    void wait(seq n);
+
+    template<typename Rep, typename Period>
+    bool wait_for(seq n, const std::chrono::duration<Rep, Period>& x)
+    {
+        std::chrono::seconds s = std::chrono::duration_cast<std::chrono::seconds>(x);
+        std::chrono::nanoseconds ns = std::chrono::duration_cast<std::chrono::nanoseconds>(x - s);
+        return wait_for(n, s, ns);
+    }
+
+    ////////////////////
+    /// \brief  sequence number of the last durable record (0 = none)
+    ///
+    seq durable() const noexcept { return _M_durable.load(std::memory_order_acquire); }
+
+    ////////////////////
+    /// \brief  sequence number of the last queued record (0 = none)
+    ///
+    seq last();
+
+    ////////////////////
+    /// \brief  call func for each durable record starting with sequence number n
+    ///
+    /// Records are read from mappings of the segment files; the span passed to func
+    /// is only valid during the call.
+    ///
+    void replay(seq n, const callback& func);
+
+protected:
+    bool wait_for(seq n, std::chrono::seconds, std::chrono::nanoseconds);
+
+private:
+    struct record
+    {
+        seq n;
+        char header[header_size];
+        std::string data;
+        std::unique_ptr<std::promise<seq>> promise;
+    };
+
+    std::string _M_path;
+    size_t _M_segment_size;
+
+    storage::file _M_file; // current segment
+    storage::offset _M_offset = 0;
+
+    std::mutex _M_mutex;
+    std::condition_variable _M_queued, _M_synced;
+
+    std::vector<record> _M_queue;
+    seq _M_next = 1;
+    std::atomic<seq> _M_durable;
+
+    std::exception_ptr _M_error;
+    bool _M_stop = false;
+
+    std::thread _M_thread;
+
+    std::string segment(seq n) const;
+    void recover();
+    void roll(seq n);
+
+    seq enqueue(const void* data, size_t n, std::unique_ptr<std::promise<seq>>);
+    void run();
+    void write(std::vector<record>&);
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+uint32_t crc32(const void* data, size_t n, uint32_t crc = 0) noexcept;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#endif // JOURNAL_HPP
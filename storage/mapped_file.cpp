@@ -0,0 +1,193 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2015 Dimitry Ishenko
+// Distributed under the GNU GPL v2. For full terms please visit:
+// http://www.gnu.org/licenses/gpl.html
+//
+// Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#include "errno_error.hpp"
+#include "mapped_file.hpp"
+
+#include <algorithm>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace storage
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+constexpr size_t mapped_file::all;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+mapped_file::mapped_file(const std::string& name, storage::mapping mapping, storage::offset offset, size_t length)
+{
+    storage::file file(name, mapping == storage::mapping::read_write ? open::read_write : open::read);
+
+    open(file.get_id(), mapping);
+    try { remap(offset, length); }
+    catch(...)
+    {
+        close();
+        throw;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+mapped_file::mapped_file(const storage::file& file, storage::mapping mapping, storage::offset offset, size_t length)
+{
+    open(file.get_id(), mapping);
+    try { remap(offset, length); }
+    catch(...)
+    {
+        close();
+        throw;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void mapped_file::open(int fd, storage::mapping mapping)
+{
+    _M_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if(_M_fd == invalid) throw errno_error();
+
+    _M_mapping = mapping;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void mapped_file::close() noexcept
+{
+    if(_M_length)
+    {
+        munmap(_M_addr, _M_length);
+
+        _M_addr = nullptr;
+        _M_length = 0;
+    }
+    _M_offset = 0;
+    _M_size = 0;
+
+    if(_M_fd != invalid)
+    {
+        ::close(_M_fd);
+        _M_fd = invalid;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t mapped_file::page_size() noexcept
+{
+    static size_t size = sysconf(_SC_PAGESIZE);
+    return size;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t mapped_file::ensure(storage::offset offset, size_t length)
+{
+    struct stat x;
+    if(fstat(_M_fd, &x)) throw errno_error();
+
+    size_t rest = x.st_size > offset ? x.st_size - offset : 0;
+    if(length == all) return rest;
+
+    // pages past the end of the file cannot be accessed (SIGBUS)
+    if(length > rest)
+    {
+        if(_M_mapping != storage::mapping::read_write) return rest;
+        if(ftruncate(_M_fd, offset + length)) throw errno_error();
+    }
+    return length;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void mapped_file::remap(storage::offset offset, size_t length)
+{
+    if(offset < 0) throw errno_error(std::make_error_code(std::errc::invalid_argument));
+    length = ensure(offset, length);
+
+    size_t delta = offset % page_size();
+    void* addr = nullptr;
+
+    if(length)
+    {
+        int prot = _M_mapping == storage::mapping::read ? PROT_READ : PROT_READ | PROT_WRITE;
+        int flags = _M_mapping == storage::mapping::copy_on_write ? MAP_PRIVATE : MAP_SHARED;
+
+        addr = mmap(nullptr, length + delta, prot, flags, _M_fd, offset - delta);
+        if(addr == MAP_FAILED) throw errno_error();
+    }
+
+    if(_M_length) munmap(_M_addr, _M_length);
+
+    _M_addr = addr;
+    _M_length = length ? length + delta : 0;
+    _M_offset = offset;
+    _M_size = length;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void mapped_file::resize(size_t length)
+{
+    if(!_M_length) return remap(_M_offset, length);
+
+    length = ensure(_M_offset, length);
+    if(!length) return remap(_M_offset, 0);
+
+    size_t delta = _M_offset % page_size();
+
+    void* addr = mremap(_M_addr, _M_length, length + delta, MREMAP_MAYMOVE);
+    if(addr == MAP_FAILED) throw errno_error();
+
+    _M_addr = addr;
+    _M_length = length + delta;
+    _M_size = length;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+app::const_span mapped_file::view(size_t pos, size_t n) const
+{
+    if(pos > _M_size) throw errno_error(std::make_error_code(std::errc::invalid_argument));
+    return app::const_span(data() + pos, std::min(n, _M_size - pos));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+app::span mapped_file::span(size_t pos, size_t n)
+{
+    if(_M_mapping == storage::mapping::read) throw errno_error(std::make_error_code(std::errc::permission_denied));
+    if(pos > _M_size) throw errno_error(std::make_error_code(std::errc::invalid_argument));
+
+    return app::span(const_cast<char*>(data()) + pos, std::min(n, _M_size - pos));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+std::pair<char*, size_t> mapped_file::range(size_t pos, size_t n) const
+{
+    if(pos > _M_size) throw errno_error(std::make_error_code(std::errc::invalid_argument));
+    n = std::min(n, _M_size - pos);
+
+    // madvise and msync want page aligned address
+    size_t beg = delta() + pos;
+    size_t skip = beg % page_size();
+
+    return std::make_pair(static_cast<char*>(_M_addr) + beg - skip, n + skip);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void mapped_file::advise(storage::advice advice, size_t pos, size_t n)
+{
+    auto x = range(pos, n);
+    if(x.second && madvise(x.first, x.second, static_cast<int>(advice))) throw errno_error();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void mapped_file::sync(bool wait, size_t pos, size_t n)
+{
+    auto x = range(pos, n);
+    if(x.second && msync(x.first, x.second, wait ? MS_SYNC : MS_ASYNC)) throw errno_error();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+}
@@ -0,0 +1,175 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2015 Dimitry Ishenko
+// Distributed under the GNU GPL v2. For full terms please visit:
+// http://www.gnu.org/licenses/gpl.html
+//
+// Contact: dimitry (dot) ishenko (at) (gee) mail (dot) com
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#include "buffer.hpp"
+#include "file.hpp"
+
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <utility>
+
+#include <sys/mman.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+namespace storage
+{
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+enum class mapping
+{
+    read,           //< read-only
+    read_write,     //< changes are written to the file
+    copy_on_write,  //< changes are private to the mapping
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+enum class advice
+{
+    normal       = MADV_NORMAL,
+    sequential   = MADV_SEQUENTIAL, //< aggressive read-ahead, pages can be dropped soon after access
+    random       = MADV_RANDOM,     //< no read-ahead
+    will_need    = MADV_WILLNEED,   //< start reading pages in now
+    dont_need    = MADV_DONTNEED,   //< pages can be dropped (re-read from the file on next access)
+    huge_page    = MADV_HUGEPAGE,   //< back with transparent huge pages (if the file system supports it)
+    no_huge_page = MADV_NOHUGEPAGE,
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// \brief  memory-mapped file
+///
+/// Gives direct access to file contents in the page cache, without copying them
+/// into heap buffers. Views returned by view and span are valid until the file
+/// is remapped or closed.
+///
+class mapped_file
+{
+public:
+    static constexpr size_t all = std::numeric_limits<size_t>::max();
+
+public:
+    mapped_file() noexcept = default;
+    mapped_file(const mapped_file&) = delete;
+    mapped_file(mapped_file&& x) noexcept { swap(x); }
+
+    ////////////////////
+    /// \brief  map file
+    /// \param  offset start of the mapped range
+    /// \param  length length of the range (or until end of file)
+    ///
+    /// The file is opened for reading, or for reading and writing with mapping::read_write.
+    ///
+    explicit mapped_file(const std::string& name, storage::mapping = storage::mapping::read, storage::offset offset = 0, size_t length = all);
+
+    ////////////////////
+    /// \brief  map open file
+    ///
+    /// The file must be open for reading (and writing with mapping::read_write). It can
+    /// be closed afterwards, as mapped_file keeps its own descriptor.
+    ///
+    explicit mapped_file(const storage::file&, storage::mapping = storage::mapping::read, storage::offset offset = 0, size_t length = all);
+
+    ~mapped_file() { close(); }
+
+    void close() noexcept;
+    bool is_open() const noexcept { return _M_fd != invalid; }
+
+    mapped_file& operator=(const mapped_file&) = delete;
+    mapped_file& operator=(mapped_file&& x) noexcept
+    {
+        swap(x);
+        return (*this);
+    }
+
+    void swap(mapped_file& x) noexcept
+    {
+        std::swap(_M_fd, x._M_fd);
+        std::swap(_M_mapping, x._M_mapping);
+        std::swap(_M_addr, x._M_addr);
+        std::swap(_M_length, x._M_length);
+        std::swap(_M_offset, x._M_offset);
+        std::swap(_M_size, x._M_size);
+    }
+
+    const char* data() const noexcept { return static_cast<const char*>(_M_addr) + delta(); }
+    size_t size() const noexcept { return _M_size; }
+    storage::offset offset() const noexcept { return _M_offset; }
+
+    ////////////////////
+    /// \brief  get read-only view of (part of) the mapped range
+    /// \param  pos start of the view relative to offset()
+    /// \param  n length of the view (clipped to the end of the range)
+    ///
+    app::const_span view(size_t pos = 0, size_t n = all) const;
+
+    ////////////////////
+    /// \brief  get writable view of (part of) the mapped range
+    ///
+    /// Throws errc::permission_denied for read-only mappings.
+    ///
+    app::span span(size_t pos = 0, size_t n = all);
+
+    ////////////////////
+    /// \brief  map another range of the file
+    ///
+    /// With mapping::read_write, the file is extended if it ends before the range.
+    ///
+    void remap(storage::offset offset, size_t length = all);
+
+    ////////////////////
+    /// \brief  grow or shrink the mapped range (eg, after the file has grown)
+    ///
+    /// Uses mremap, which can often extend the mapping in place.
+    /// With mapping::read_write, the file is extended if necessary.
+    ///
+    void resize(size_t length);
+
+    ////////////////////
+    /// \brief  give the kernel a hint about how part of the range will be accessed
+    ///
+    void advise(storage::advice, size_t pos = 0, size_t n = all);
+
+    ////////////////////
+    /// \brief  write changes to the file
+    /// \param  wait wait for the write to complete (MS_SYNC), or only schedule it (MS_ASYNC)
+    ///
+    void sync(bool wait = true, size_t pos = 0, size_t n = all);
+
+    int get_id() const noexcept { return _M_fd; }
+
+private:
+    static constexpr int invalid = -1;
+
+    int _M_fd = invalid;
+    storage::mapping _M_mapping = storage::mapping::read;
+
+    void* _M_addr = nullptr;  // page aligned
+    size_t _M_length = 0;     // mapped length (from _M_addr)
+
+    storage::offset _M_offset = 0;
+    size_t _M_size = 0;
+
+    size_t delta() const noexcept { return _M_length ? _M_offset % page_size() : 0; }
+    static size_t page_size() noexcept;
+
+    void open(int fd, storage::mapping);
+    size_t ensure(storage::offset offset, size_t length);
+
+    // page aligned range containing [pos, pos + n) of the view
+    std::pair<char*, size_t> range(size_t pos, size_t n) const;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#endif // MAPPED_FILE_HPP
@@ -7,60 +7,131 @@
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 #include "errno_error.hpp"
+#include "socket/socket_probe.hpp"
 #include "unix_socket.hpp"
 
+#include <algorithm>
+#include <cstddef>
 #include <cstring>
-#include <memory>
+#include <system_error>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 namespace unix
 {
 
+///////////////////////////////////////////////////////////////////////////////////////////////////
+constexpr size_t socket::fds_max;
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 socket::socket(socket::type x): app::socket(AF_UNIX, x) { }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
-sockaddr_un socket::from(const std::string& path)
+std::pair<unix::socket, unix::socket> socket::pair(socket::type type)
 {
-    sockaddr_un addr;
+    int fds[2];
+    if(::socketpair(AF_UNIX, type == socket::datagram ? SOCK_DGRAM : SOCK_STREAM, 0, fds)) throw errno_error();
+
+    std::pair<unix::socket, unix::socket> pair;
+    pair.first._M_fd = fds[0];
+    pair.second._M_fd = fds[1];
+
+    return pair;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+socklen_t socket::from(const std::string& path, sockaddr_un& addr)
+{
+    bool abstract = path.size() && path[0] == '\0';
+
+    // filesystem paths need room for the terminating null
+    if(path.size() + (abstract ? 0 : 1) > sizeof(addr.sun_path))
+        throw errno_error(std::make_error_code(std::errc::filename_too_long));
 
     addr.sun_family = AF_UNIX;
-    size_t count = path.copy(addr.sun_path, sizeof(addr.sun_path) - 1);
-    addr.sun_path[count] = '\0';
+    if(path.empty()) return offsetof(sockaddr_un, sun_path); // autobind
 
-    return addr;
+    path.copy(addr.sun_path, path.size());
+    if(!abstract) addr.sun_path[path.size()] = '\0';
+
+    return offsetof(sockaddr_un, sun_path) + path.size() + (abstract ? 0 : 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+std::string socket::to(const sockaddr_un& addr, socklen_t addr_len)
+{
+    if(addr.sun_family != AF_UNIX || addr_len <= offsetof(sockaddr_un, sun_path)) return std::string(); // unnamed
+
+    size_t size = std::min<size_t>(addr_len - offsetof(sockaddr_un, sun_path), sizeof(addr.sun_path));
+    if(addr.sun_path[0] == '\0') return std::string(addr.sun_path, size); // abstract
+
+    return std::string(addr.sun_path, strnlen(addr.sun_path, size));
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 void socket::bind(const std::string& path)
 {
-    sockaddr_un addr = from(path);
-    base::bind((sockaddr*)&addr, sizeof(addr));
+    sockaddr_un addr;
+    base::bind((sockaddr*)&addr, from(path, addr));
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 void socket::connect(const std::string& path)
 {
-    sockaddr_un addr = from(path);
-    base::connect((sockaddr*)&addr, sizeof(addr));
+    sockaddr_un addr;
+    base::connect((sockaddr*)&addr, from(path, addr));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void socket::connect(const std::string& path, std::chrono::seconds s, std::chrono::nanoseconds n)
+{
+    sockaddr_un addr;
+    base::connect((sockaddr*)&addr, from(path, addr), s, n);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+bool socket::begin_connect(const std::string& path)
+{
+    sockaddr_un addr;
+    return base::begin_connect((sockaddr*)&addr, from(path, addr));
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 size_t socket::send_to(const std::string& path, const void* buffer, size_t n, bool wait)
 {
-    sockaddr_un addr = from(path);
-    return base::send_to((sockaddr*)&addr, sizeof(addr), buffer, n, wait);
+    sockaddr_un addr;
+    return base::send_to((sockaddr*)&addr, from(path, addr), buffer, n, wait);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t socket::send_to(const std::string& path, const app::const_span* spans, size_t n, bool wait)
+{
+    sockaddr_un addr;
+    return base::send_to((sockaddr*)&addr, from(path, addr), spans, n, wait);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 size_t socket::recv_from(std::string& path, std::string& string, size_t max, bool wait)
 {
-    std::unique_ptr<char[]> buffer(new char[max + 1]);
+    string.resize(max);
 
-    ssize_t count = recv_from(path, buffer.get(), max, wait);
-    buffer[count] = '\0';
+    size_t count = recv_from(path, &string[0], max, wait);
+    string.resize(count);
+
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t socket::recv_from(std::string& path, app::buffer& buffer, size_t max, bool wait)
+{
+    buffer.resize(max);
+
+    size_t count = recv_from(path, buffer.data(), max, wait);
+    buffer.resize(count);
 
-    string.assign(buffer.get(), count);
     return count;
 }
 
@@ -72,11 +143,229 @@ size_t socket::recv_from(std::string& path, void* buffer, size_t n, bool wait)
     memset(&addr, 0, addr_len);
 
     ssize_t count = base::recv_from((sockaddr*)&addr, addr_len, buffer, n, wait);
+    path = to(addr, addr_len);
+
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+unix::peer socket::get_peer() const
+{
+    ucred cred;
+    socklen_t len = sizeof(cred);
+    if(getsockopt(_M_fd, SOL_SOCKET, SO_PEERCRED, &cred, &len)) throw errno_error();
+
+    unix::peer peer;
+    peer.pid = cred.pid;
+    peer.uid = cred.uid;
+    peer.gid = cred.gid;
+
+    return peer;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void socket::set_pass_cred(bool x)
+{
+    set_option(SOL_SOCKET, SO_PASSCRED, x ? 1 : 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t socket::send_fds(const void* buffer, size_t size, const int* fds, size_t n, bool wait)
+{
+    if(n > fds_max) throw errno_error(std::make_error_code(std::errc::invalid_argument));
+
+    union
+    {
+        cmsghdr align;
+        char data[CMSG_SPACE(sizeof(int) * fds_max)];
+    }
+    control;
+
+    iovec iov = { const_cast<void*>(buffer), size };
+
+    msghdr msg = { };
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    if(n)
+    {
+        msg.msg_control = control.data;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * n);
+
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * n);
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * n);
+    }
+
+    app::socket_probe probe(*this, true, wait);
+    ssize_t count = ::sendmsg(_M_fd, &msg, (wait ? 0 : MSG_DONTWAIT) | MSG_NOSIGNAL);
+    if(count == -1)
+    {
+        probe.fail(errno);
+        if(!wait && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 0;
+        else throw errno_error();
+    }
+    probe.done(count, size);
+
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t socket::recv_fds(void* buffer, size_t size, int* fds, size_t& n, bool wait)
+{
+    return recv_msg(buffer, size, fds, &n, nullptr, wait);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t socket::recv_cred(void* buffer, size_t size, unix::peer& peer, bool wait)
+{
+    return recv_msg(buffer, size, nullptr, nullptr, &peer, wait);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t socket::recv_msg(void* buffer, size_t size, int* fds, size_t* n, unix::peer* peer, bool wait)
+{
+    union
+    {
+        cmsghdr align;
+        char data[CMSG_SPACE(sizeof(int) * fds_max) + CMSG_SPACE(sizeof(ucred))];
+    }
+    control;
+
+    iovec iov = { buffer, size };
+
+    msghdr msg = { };
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data;
+    msg.msg_controllen = sizeof(control.data);
 
-    if(addr.sun_family == AF_UNIX) path.assign(addr.sun_path);
+    size_t max = n ? *n : 0;
+    if(n) *n = 0;
+
+    app::socket_probe probe(*this, false, wait);
+    ssize_t count = ::recvmsg(_M_fd, &msg, (wait ? 0 : MSG_DONTWAIT) | MSG_CMSG_CLOEXEC);
+    if(count == -1)
+    {
+        probe.fail(errno);
+        if(!wait && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 0;
+        else throw errno_error();
+    }
+    probe.done(count);
+
+    for(cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if(cmsg->cmsg_level != SOL_SOCKET) continue;
+
+        if(cmsg->cmsg_type == SCM_RIGHTS)
+        {
+            size_t total = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            const unsigned char* data = CMSG_DATA(cmsg);
+
+            for(size_t i = 0; i < total; ++i)
+            {
+                int fd;
+                memcpy(&fd, data + i * sizeof(int), sizeof(int));
+
+                if(n && *n < max)
+                    fds[(*n)++] = fd;
+                else ::close(fd);
+            }
+        }
+        else if(cmsg->cmsg_type == SCM_CREDENTIALS && peer)
+        {
+            ucred cred;
+            memcpy(&cred, CMSG_DATA(cmsg), sizeof(cred));
+
+            peer->pid = cred.pid;
+            peer->uid = cred.uid;
+            peer->gid = cred.gid;
+        }
+    }
 
     return count;
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t socket::send_many(unix::packet* packets, size_t n, bool wait)
+{
+    mmsghdr msgs[batch_max];
+    iovec iov[batch_max];
+    sockaddr_un addr[batch_max];
+
+    size_t done = 0;
+    while(done < n)
+    {
+        size_t count = std::min(n - done, batch_max);
+        memset(msgs, 0, count * sizeof(mmsghdr));
+
+        for(size_t i = 0; i < count; ++i)
+        {
+            unix::packet& packet = packets[done + i];
+            iov[i].iov_base = packet.buffer;
+            iov[i].iov_len = packet.size;
+
+            msgs[i].msg_hdr.msg_name = &addr[i];
+            msgs[i].msg_hdr.msg_namelen = from(packet.path, addr[i]);
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        size_t sent = base::send_many(msgs, count, wait);
+        for(size_t i = 0; i < sent; ++i) packets[done + i].count = msgs[i].msg_len;
+
+        done += sent;
+        if(sent < count) break;
+    }
+
+    return done;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t socket::recv_many(unix::packet* packets, size_t n, bool wait)
+{
+    mmsghdr msgs[batch_max];
+    iovec iov[batch_max];
+    sockaddr_un addr[batch_max];
+
+    size_t done = 0;
+    while(done < n)
+    {
+        size_t count = std::min(n - done, batch_max);
+        memset(msgs, 0, count * sizeof(mmsghdr));
+        memset(addr, 0, count * sizeof(sockaddr_un));
+
+        for(size_t i = 0; i < count; ++i)
+        {
+            iov[i].iov_base = packets[done + i].buffer;
+            iov[i].iov_len = packets[done + i].size;
+
+            msgs[i].msg_hdr.msg_name = &addr[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(addr[i]);
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        // only the first batch may block
+        size_t recvd = base::recv_many(msgs, count, wait && done == 0);
+        for(size_t i = 0; i < recvd; ++i)
+        {
+            unix::packet& packet = packets[done + i];
+            packet.count = msgs[i].msg_len;
+
+            packet.path = to(addr[i], msgs[i].msg_hdr.msg_namelen);
+        }
+
+        done += recvd;
+        if(recvd < count) break;
+    }
+
+    return done;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 }
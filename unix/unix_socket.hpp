@@ -10,9 +10,14 @@
 #define UNIX_SOCKET_HPP
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
+#include "credentials/credentials.hpp"
 #include "socket/socket.hpp"
 
+#include <initializer_list>
 #include <string>
+#include <utility>
+
+#include <sys/types.h>
 #include <sys/un.h>
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -22,6 +27,48 @@
 namespace unix
 {
 
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// \brief make abstract namespace address (Linux)
+///
+/// Abstract addresses start with a null byte, have no filesystem presence and
+/// disappear when the last socket bound to them is closed.
+///
+inline std::string abstract(const std::string& name) { return std::string(1, '\0') + name; }
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// \brief datagram descriptor for send_many/recv_many
+///
+struct packet
+{
+    packet() = default;
+
+    // receive into buffer
+    packet(void* buffer, size_t size) noexcept: buffer(buffer), size(size) { }
+
+    // send buffer to path
+    packet(std::string path, const void* buffer, size_t size):
+        path(std::move(path)), buffer(const_cast<void*>(buffer)), size(size)
+    { }
+
+    std::string path;
+
+    void* buffer = nullptr;
+    size_t size = 0;  //< buffer size
+    size_t count = 0; //< number of bytes sent or received
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// \brief peer process credentials
+///
+struct peer
+{
+    pid_t pid = 0;
+    app::uid uid = app::invalid_uid;
+    app::gid gid = app::invalid_gid;
+
+    app::credentials credentials() const { return app::credentials(uid, gid); }
+};
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 class socket: public app::socket
 {
@@ -29,6 +76,8 @@ public:
     typedef app::socket::id id;
     typedef app::socket::type type;
 
+    static constexpr size_t fds_max = 253; // SCM_MAX_FD
+
 public:
     socket() noexcept = default;
     socket(const socket&) = delete;
@@ -43,18 +92,135 @@ public:
         return (*this);
     }
 
+    ////////////////////
+    /// \brief create pair of connected sockets (socketpair)
+    ///
+    /// Useful to talk to a forked child process without touching the filesystem.
+    ///
+    static std::pair<unix::socket, unix::socket> pair(socket::type = socket::stream);
+
+    ////////////////////
+    /// \brief bind socket to path
+    ///
+    /// Paths starting with a null byte are abstract namespace addresses (see
+    /// unix::abstract). Throws errno_error with std::errc::filename_too_long if the
+    /// path does not fit into sockaddr_un.
+    ///
     void bind(const std::string& path);
     void connect(const std::string& path);
 
+    ////////////////////
+    /// \brief connect with timeout
+    ///
+    /// Throws errno_error with std::errc::timed_out if the connection could not be
+    /// established in time.
+    ///
+    template<typename Rep, typename Period>
+    void connect(const std::string& path, const std::chrono::duration<Rep, Period>& x)
+    {
+        std::chrono::seconds s = std::chrono::duration_cast<std::chrono::seconds>(x);
+        std::chrono::nanoseconds n = std::chrono::duration_cast<std::chrono::nanoseconds>(x - s);
+        connect(path, s, n);
+    }
+
+    ////////////////////
+    /// \brief start connecting without blocking
+    /// \return true if connected right away
+    ///
+    /// Puts the socket into non-blocking mode. Otherwise, wait for the socket to become
+    /// writable (eg, can_send or reactor) and call finish_connect.
+    ///
+    bool begin_connect(const std::string& path);
+
     size_t send_to(const std::string& path, const std::string& string, bool wait = true)
         { return send_to(path, string.data(), string.size(), wait); }
     size_t send_to(const std::string& path, const void* buffer, size_t n, bool wait = true);
 
+    size_t send_to(const std::string& path, std::initializer_list<app::const_span> spans, bool wait = true)
+        { return send_to(path, spans.begin(), spans.size(), wait); }
+    size_t send_to(const std::string& path, const app::const_span* spans, size_t n, bool wait = true);
+
     size_t recv_from(std::string& path, std::string& string, size_t max, bool wait = true);
+    size_t recv_from(std::string& path, app::buffer& buffer, size_t max, bool wait = true);
     size_t recv_from(std::string& path, void* buffer, size_t n, bool wait = true);
 
+    ////////////////////
+    /// \brief send several datagrams with as few syscalls as possible (sendmmsg)
+    /// \return number of packets sent
+    ///
+    size_t send_many(unix::packet* packets, size_t n, bool wait = true);
+
+    ////////////////////
+    /// \brief receive several datagrams with as few syscalls as possible (recvmmsg)
+    /// \return number of packets received
+    ///
+    /// If wait is true, blocks until at least one datagram arrives.
+    ///
+    size_t recv_many(unix::packet* packets, size_t n, bool wait = true);
+
+    template<typename Rep, typename Period>
+    size_t recv_many(unix::packet* packets, size_t n, const std::chrono::duration<Rep, Period>& x)
+    {
+        return can_recv(x) ? recv_many(packets, n, false) : 0;
+    }
+
+    ////////////////////
+    /// \brief get credentials of the connected peer (SO_PEERCRED)
+    ///
+    /// These are the credentials at the time of connect (or socketpair).
+    ///
+    unix::peer get_peer() const;
+
+    ////////////////////
+    /// \brief send file descriptors along with data (SCM_RIGHTS)
+    /// \param fds up to fds_max file descriptors, which are passed in one message
+    /// \return number of bytes sent
+    ///
+    /// The descriptors stay open on this end. At least one byte of data must
+    /// accompany them on stream sockets; the overloads without data send a null byte.
+    ///
+    size_t send_fds(const void* buffer, size_t size, const int* fds, size_t n, bool wait = true);
+    size_t send_fds(const int* fds, size_t n, bool wait = true)
+    {
+        char c = 0;
+        return send_fds(&c, sizeof(c), fds, n, wait);
+    }
+    size_t send_fds(std::initializer_list<int> fds, bool wait = true)
+        { return send_fds(fds.begin(), fds.size(), wait); }
+
+    ////////////////////
+    /// \brief receive file descriptors along with data (SCM_RIGHTS)
+    /// \param n in: capacity of fds; out: number of descriptors received
+    /// \return number of bytes received
+    ///
+    /// Received descriptors are close-on-exec. Those that do not fit into fds are closed.
+    ///
+    size_t recv_fds(void* buffer, size_t size, int* fds, size_t& n, bool wait = true);
+    size_t recv_fds(int* fds, size_t& n, bool wait = true)
+    {
+        char c;
+        return recv_fds(&c, sizeof(c), fds, n, wait);
+    }
+
+    ////////////////////
+    /// \brief have the kernel attach sender credentials to received messages (SO_PASSCRED)
+    ///
+    void set_pass_cred(bool);
+
+    ////////////////////
+    /// \brief receive data along with the sender credentials (SCM_CREDENTIALS)
+    ///
+    /// Requires set_pass_cred(true); otherwise peer is left unchanged.
+    ///
+    size_t recv_cred(void* buffer, size_t size, unix::peer& peer, bool wait = true);
+
 private:
-    sockaddr_un from(const std::string&);
+    static socklen_t from(const std::string&, sockaddr_un&);
+    static std::string to(const sockaddr_un&, socklen_t);
+    void connect(const std::string&, std::chrono::seconds, std::chrono::nanoseconds);
+
+    size_t recv_msg(void* buffer, size_t size, int* fds, size_t* n, unix::peer* peer, bool wait);
+
     using base = app::socket;
 };
 